@@ -5,6 +5,7 @@
 // 2011-07-12 Zou Xu <zouivex@gmail.com>
 // 2012-02-11 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <queue>
 #include <boost/range/adaptor/reversed.hpp>
 #include <rime/algo/syllabifier.h>
@@ -23,10 +24,173 @@ const double kCompletionPenalty = -0.6931471805599453;            // log(0.5)
 const double kPenaltyForAmbiguousSyllable = -2.3025850929940455;  // log(0.1)
 const double kCorrectionCredibility = -16.11809565095832;         // log(1e-7)
 const double kPenaltyForDisfavoredType = -32.23619130191664;      // log(1e-14)
+const size_t kCorrectionTolerance = 4;
+
+void SyllabifierCache::Update(const string& new_input) {
+  size_t common_prefix_length = 0;
+  size_t max_length = (std::min)(input.length(), new_input.length());
+  while (common_prefix_length < max_length &&
+         input[common_prefix_length] == new_input[common_prefix_length]) {
+    ++common_prefix_length;
+  }
+  bool is_truncated = common_prefix_length == new_input.length();
+  bool is_extended = common_prefix_length == input.length();
+  for (auto it = records.begin(); it != records.end();) {
+    size_t pos = it->first;
+    auto& record = it->second;
+    if (pos < common_prefix_length) {
+      if (pos + record.reach < common_prefix_length) {
+        // the search from this vertex stopped within the common prefix,
+        // so would it in the new input.
+        ++it;
+        continue;
+      }
+      if (is_truncated) {
+        if (pos + record.reach > common_prefix_length) {
+          // the new input is a prefix of the cached one; keep the spellings
+          // that are still within the input.
+          auto& matches = record.matches;
+          matches.erase(std::remove_if(matches.begin(), matches.end(),
+                                       [&](const SpellingMatch& m) {
+                                         return pos + m.length >
+                                                common_prefix_length;
+                                       }),
+                        matches.end());
+          record.reach = common_prefix_length - pos;
+          record.node_pos = kNoNode;
+          record.stopped = false;
+        }
+        ++it;
+        continue;
+      }
+      if (is_extended && !record.stopped && record.node_pos != kNoNode) {
+        // the search reached the end of input; resume it from there.
+        ++it;
+        continue;
+      }
+    }
+    it = records.erase(it);
+  }
+  for (auto it = corrections.begin(); it != corrections.end();) {
+    size_t end_pos = it->first.first + it->second.key.length();
+    // a key that was not truncated ended with the input
+    bool is_complete =
+        it->second.truncated || end_pos == new_input.length();
+    if (end_pos <= common_prefix_length && is_complete) {
+      ++it;
+    } else {
+      it = corrections.erase(it);
+    }
+  }
+  input = new_input;
+}
+
+// searches on from where the record has got to.
+static void search_spellings(const string& input,
+                             size_t start_pos,
+                             Prism& prism,
+                             SyllabifierCache::Record* record) {
+  std::string_view key(input);
+  key.remove_prefix(start_pos);
+  Prism::Cursor cursor;
+  cursor.node_pos = record->node_pos;
+  cursor.key_pos = record->reach;
+  cursor.stopped = record->stopped;
+  const size_t kBufferSize = 8;
+  Prism::Match buffer[kBufferSize];
+  size_t num_results;
+  do {
+    num_results = prism.Traverse(key, &cursor, buffer, kBufferSize);
+    for (size_t i = 0; i < num_results; ++i) {
+      record->matches.push_back({buffer[i].value, buffer[i].length});
+    }
+  } while (num_results == kBufferSize);
+  record->node_pos = cursor.node_pos;
+  record->reach = cursor.key_pos;
+  record->stopped = cursor.stopped;
+}
+
+const SyllabifierCache::Record& Syllabifier::MatchSpellings(
+    const string& input,
+    size_t current_pos,
+    Prism& prism,
+    SyllabifierCache::Record* temp) {
+  if (!cache_) {
+    search_spellings(input, current_pos, prism, temp);
+    return *temp;
+  }
+  auto found = cache_->records.find(current_pos);
+  if (found != cache_->records.end()) {
+    auto& record = found->second;
+    DLOG(INFO) << "reuse cached spellings at " << current_pos;
+    if (!record.stopped && current_pos + record.reach < input.length()) {
+      search_spellings(input, current_pos, prism, &record);
+    }
+    return record;
+  }
+  auto& record = cache_->records[current_pos];
+  search_spellings(input, current_pos, prism, &record);
+  return record;
+}
+
+static size_t max_spelling_length(Prism& prism) {
+  vector<Prism::Match> spellings;
+  prism.ExpandSearch(string(), &spellings, 0);
+  size_t max_length = 0;
+  for (const auto& m : spellings) {
+    max_length = (std::max)(max_length, m.length);
+  }
+  return max_length;
+}
+
+static void search_corrections(Corrector* corrector,
+                               const string& key,
+                               Prism& prism,
+                               SyllabifierCache::CorrectionRecord* record) {
+  record->key = key;
+  record->matches.clear();
+  Corrections corrections;
+  corrector->ToleranceSearch(prism, key, &corrections, kCorrectionTolerance);
+  for (const auto& c : corrections) {
+    record->matches.push_back(
+        {c.first, c.second.length, c.second.distance});
+  }
+}
+
+const vector<CorrectionMatch>& Syllabifier::SearchCorrections(
+    const string& input,
+    size_t current_pos,
+    Prism& prism,
+    SyllabifierCache::CorrectionRecord* temp) {
+  if (!cache_) {
+    search_corrections(corrector_, input.substr(current_pos), prism, temp);
+    return temp->matches;
+  }
+  if (cache_->correction_prism != &prism) {
+    cache_->correction_prism = &prism;
+    cache_->max_correction_key_length =
+        max_spelling_length(prism) + kCorrectionTolerance;
+    cache_->corrections.clear();
+  }
+  SyllabifierCache::CorrectionKey key{current_pos, kCorrectionTolerance};
+  auto found = cache_->corrections.find(key);
+  if (found != cache_->corrections.end()) {
+    DLOG(INFO) << "reuse cached corrections at " << current_pos;
+    return found->second.matches;
+  }
+  auto& record = cache_->corrections[key];
+  size_t max_key_length = cache_->max_correction_key_length;
+  search_corrections(corrector_, input.substr(current_pos, max_key_length),
+                     prism, &record);
+  record.truncated = input.length() - current_pos > max_key_length;
+  return record.matches;
+}
 
 int Syllabifier::BuildSyllableGraph(const string& input,
                                     Prism& prism,
                                     SyllableGraph* graph) {
+  if (cache_)
+    cache_->Update(input);
   if (input.empty())
     return 0;
 
@@ -55,22 +219,25 @@ int Syllabifier::BuildSyllableGraph(const string& input,
     // see where we can go by advancing a syllable
     vector<Prism::Match> matches;
     set<SyllableId> exact_match_syllables;
-    auto current_input = input.substr(current_pos);
-    prism.CommonPrefixSearch(current_input, &matches);
+    SyllabifierCache::Record temp;
+    for (const auto& m :
+         MatchSpellings(input, current_pos, prism, &temp).matches) {
+      matches.push_back({m.spelling_id, m.length});
+    }
     size_t min_distance = -1;
     if (corrector_) {
       for (auto& m : matches) {
         exact_match_syllables.insert(m.value);
       }
-      Corrections corrections;
-      corrector_->ToleranceSearch(prism, current_input, &corrections, 4);
-      for (const auto& m : corrections) {
-        for (auto accessor = prism.QuerySpelling(m.first);
+      SyllabifierCache::CorrectionRecord temp_corrections;
+      for (const auto& m :
+           SearchCorrections(input, current_pos, prism, &temp_corrections)) {
+        for (auto accessor = prism.QuerySpelling(m.spelling_id);
              !accessor.exhausted(); accessor.Next()) {
           if (accessor.properties().type == kNormalSpelling) {
-            matches.push_back({m.first, m.second.length, m.second.distance});
-            if (m.second.distance < min_distance) {
-              min_distance = m.second.distance;
+            matches.push_back({m.spelling_id, m.length, m.distance});
+            if (m.distance < min_distance) {
+              min_distance = m.distance;
             }
             break;
           }
@@ -301,21 +468,77 @@ void Syllabifier::CheckOverlappedSpellings(SyllableGraph* graph,
 }
 
 void Syllabifier::Transpose(SyllableGraph* graph) {
-  graph->indices.clear();
-  graph->indices.resize(graph->interpreted_length);
-  for (const auto& start : graph->edges) {
-    auto& index(graph->indices[start.first]);
-    for (const auto& end : boost::adaptors::reverse(start.second)) {
+  graph->indices.Build(graph->edges, graph->interpreted_length);
+}
+
+void SpellingIndices::Build(const EdgeMap& edges, size_t interpreted_length) {
+  clear();
+  vertex_offsets_.reserve(interpreted_length + 1);
+  // sized once for all vertices
+  size_t num_spellings = 0;
+  size_t max_vertex_spellings = 0;
+  for (const auto& start : edges) {
+    size_t n = 0;
+    for (const auto& end : start.second)
+      n += end.second.size();
+    num_spellings += n;
+    max_vertex_spellings = (std::max)(max_vertex_spellings, n);
+  }
+  syllables_.reserve(num_spellings);
+  spellings_.reserve(num_spellings);
+  vector<std::pair<SyllableId, IndexedSpelling>> vertex_spellings;
+  vertex_spellings.reserve(max_vertex_spellings);
+  auto start = edges.begin();
+  for (size_t pos = 0; pos < interpreted_length; ++pos) {
+    vertex_offsets_.push_back(static_cast<uint32_t>(syllables_.size()));
+    if (start == edges.end() || start->first != pos)
+      continue;
+    vertex_spellings.clear();
+    for (const auto& end : boost::adaptors::reverse(start->second)) {
       for (const auto& spelling : end.second) {
-        SyllableId syll_id = spelling.first;
-        index[syll_id].push_back(&spelling.second);
+        const auto& props = spelling.second;
+        vertex_spellings.push_back(
+            {spelling.first,
+             {end.first, props.type, props.is_correction, props.credibility}});
       }
     }
+    // group by syllable id, keeping longer spellings first.
+    std::stable_sort(vertex_spellings.begin(), vertex_spellings.end(),
+                     [](const auto& a, const auto& b) {
+                       return a.first < b.first;
+                     });
+    for (const auto& x : vertex_spellings) {
+      if (syllables_.size() == vertex_offsets_.back() ||
+          syllables_.back().syllable_id != x.first) {
+        uint32_t offset = static_cast<uint32_t>(spellings_.size());
+        syllables_.push_back({x.first, offset, offset});
+      }
+      spellings_.push_back(x.second);
+      ++syllables_.back().spelling_end;
+    }
+    ++start;
   }
+  vertex_offsets_.push_back(static_cast<uint32_t>(syllables_.size()));
+}
+
+const IndexedSyllable* SpellingIndices::Find(size_t start_pos,
+                                             SyllableId syllable_id) const {
+  auto range = syllables(start_pos);
+  auto found = std::lower_bound(range.begin(), range.end(), syllable_id,
+                                [](const IndexedSyllable& s, SyllableId id) {
+                                  return s.syllable_id < id;
+                                });
+  if (found == range.end() || found->syllable_id != syllable_id)
+    return nullptr;
+  return found;
 }
 
 void Syllabifier::EnableCorrection(Corrector* corrector) {
   corrector_ = corrector;
 }
 
+void Syllabifier::EnableCache(SyllabifierCache* cache) {
+  cache_ = cache;
+}
+
 }  // namespace rime
@@ -30,9 +30,74 @@ using VertexMap = map<size_t, SpellingType>;
 using EndVertexMap = map<size_t, SpellingMap>;
 using EdgeMap = map<size_t, EndVertexMap>;
 
-using SpellingPropertiesList = vector<const EdgeProperties*>;
-using SpellingIndex = map<SyllableId, SpellingPropertiesList>;
-using SpellingIndices = vector<SpellingIndex>;
+// an edge of the transposed syllable graph.
+struct IndexedSpelling {
+  size_t end_pos;
+  SpellingType type;
+  bool is_correction;
+  double credibility;
+};
+
+// the spellings of a syllable that start at a vertex, longest first.
+struct IndexedSyllable {
+  SyllableId syllable_id;
+  uint32_t spelling_begin;
+  uint32_t spelling_end;
+};
+
+template <class T>
+class IndexRange {
+ public:
+  IndexRange(const T* begin, const T* end) : begin_(begin), end_(end) {}
+  const T* begin() const { return begin_; }
+  const T* end() const { return end_; }
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  const T& operator[](size_t i) const { return begin_[i]; }
+
+ private:
+  const T* begin_;
+  const T* end_;
+};
+
+// the syllable graph transposed into contiguous arrays, indexed by the start
+// vertex, then by syllable id in ascending order. the graph itself is still
+// built in the edge maps, which the syllabifier prunes in place; the arrays
+// serve the lookups that walk it.
+class SpellingIndices {
+ public:
+  RIME_API void Build(const EdgeMap& edges, size_t interpreted_length);
+  void clear() {
+    vertex_offsets_.clear();
+    syllables_.clear();
+    spellings_.clear();
+  }
+  // number of indexed vertices, i.e. the interpreted length of input.
+  size_t size() const {
+    return vertex_offsets_.empty() ? 0 : vertex_offsets_.size() - 1;
+  }
+  bool empty() const { return size() == 0; }
+
+  IndexRange<IndexedSyllable> syllables(size_t start_pos) const {
+    if (start_pos >= size())
+      return {nullptr, nullptr};
+    const auto* base = syllables_.data();
+    return {base + vertex_offsets_[start_pos],
+            base + vertex_offsets_[start_pos + 1]};
+  }
+  IndexRange<IndexedSpelling> spellings(const IndexedSyllable& syllable) const {
+    const auto* base = spellings_.data();
+    return {base + syllable.spelling_begin, base + syllable.spelling_end};
+  }
+  // returns nullptr if the syllable does not start at the given vertex.
+  RIME_API const IndexedSyllable* Find(size_t start_pos,
+                                       SyllableId syllable_id) const;
+
+ private:
+  vector<uint32_t> vertex_offsets_;
+  vector<IndexedSyllable> syllables_;
+  vector<IndexedSpelling> spellings_;
+};
 
 struct SyllableGraph {
   size_t input_length = 0;
@@ -42,6 +107,62 @@ struct SyllableGraph {
   SpellingIndices indices;
 };
 
+// a spelling found in the prism that matches input at some position.
+struct SpellingMatch {
+  SyllableId spelling_id;
+  size_t length;
+};
+
+// a spelling near to input at some position, found by the corrector.
+struct CorrectionMatch {
+  SyllableId spelling_id;
+  size_t length;
+  size_t distance;
+};
+
+// remembers the spellings that matched the last syllabified input at each
+// visited vertex, so that the syllable graph of the next input sharing
+// a common prefix can be built without searching the prism from scratch.
+struct SyllabifierCache {
+  struct Record {
+    vector<SpellingMatch> matches;
+    // length of the longest prefix of input from the vertex that is
+    // a valid path in the prism.
+    size_t reach = 0;
+    // trie node at the end of the path, from which to extend the search
+    // when more input follows; kNoNode once that is unknown.
+    size_t node_pos = 0;
+    // whether the next character of input leads out of the prism.
+    bool stopped = false;
+  };
+  static const size_t kNoNode = size_t(-1);
+  struct CorrectionRecord {
+    // input searched from the vertex
+    string key;
+    // whether the input went on beyond the key
+    bool truncated = false;
+    vector<CorrectionMatch> matches;
+  };
+  // by vertex and tolerance
+  using CorrectionKey = pair<size_t, size_t>;
+
+  string input;
+  map<size_t, Record> records;
+  map<CorrectionKey, CorrectionRecord> corrections;
+  // the corrector is given no more input from a vertex than the longest
+  // spelling in the prism plus the tolerance; 0 until found for the prism.
+  size_t max_correction_key_length = 0;
+  const Prism* correction_prism = nullptr;
+
+  // drops the records invalidated by the new input.
+  RIME_API void Update(const string& new_input);
+  void Clear() {
+    input.clear();
+    records.clear();
+    corrections.clear();
+  }
+};
+
 class Syllabifier {
  public:
   Syllabifier() = default;
@@ -56,8 +177,20 @@ class Syllabifier {
                                   Prism& prism,
                                   SyllableGraph* graph);
   RIME_API void EnableCorrection(Corrector* corrector);
+  // reuses the prism and corrector searches of the last input; the graph
+  // itself is built anew from them.
+  RIME_API void EnableCache(SyllabifierCache* cache);
 
  protected:
+  const SyllabifierCache::Record& MatchSpellings(const string& input,
+                                                 size_t current_pos,
+                                                 Prism& prism,
+                                                 SyllabifierCache::Record* temp);
+  const vector<CorrectionMatch>& SearchCorrections(
+      const string& input,
+      size_t current_pos,
+      Prism& prism,
+      SyllabifierCache::CorrectionRecord* temp);
   void CheckOverlappedSpellings(SyllableGraph* graph, size_t start, size_t end);
   void Transpose(SyllableGraph* graph);
 
@@ -65,6 +198,7 @@ class Syllabifier {
   bool enable_completion_ = false;
   bool strict_spelling_ = false;
   Corrector* corrector_ = nullptr;
+  SyllabifierCache* cache_ = nullptr;
 };
 
 }  // namespace rime
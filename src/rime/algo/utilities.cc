@@ -39,6 +39,10 @@ void ChecksumComputer::ProcessFile(const path& file_path) {
   crc_.process_bytes(file_content.data(), file_content.length());
 }
 
+void ChecksumComputer::ProcessBytes(const void* data, size_t length) {
+  crc_.process_bytes(data, length);
+}
+
 uint32_t ChecksumComputer::Checksum() {
   return crc_.checksum();
 }
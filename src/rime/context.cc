@@ -4,6 +4,7 @@
 //
 // 2011-05-08 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <utility>
 #include <rime/candidate.h>
 #include <rime/context.h>
@@ -27,10 +28,12 @@ bool Context::Commit() {
 string Context::GetCommitText() const {
   if (get_option("dumb"))
     return string();
+  ComposeIfOutdated();
   return composition_.GetCommitText();
 }
 
 string Context::GetScriptText() const {
+  ComposeIfOutdated();
   return composition_.GetScriptText();
 }
 
@@ -43,14 +46,19 @@ string Context::GetSoftCursor() const {
 }
 
 Preedit Context::GetPreedit() const {
+  ComposeIfOutdated();
   return composition_.GetPreedit(input_, caret_pos_, GetSoftCursor());
 }
 
 bool Context::IsComposing() const {
-  return !input_.empty() || !composition_.empty();
+  if (!input_.empty())
+    return true;
+  ComposeIfOutdated();
+  return !composition_.empty();
 }
 
 bool Context::HasMenu() const {
+  ComposeIfOutdated();
   if (composition_.empty())
     return false;
   const auto& menu(composition_.back().menu);
@@ -58,6 +66,7 @@ bool Context::HasMenu() const {
 }
 
 an<Candidate> Context::GetSelectedCandidate() const {
+  ComposeIfOutdated();
   if (composition_.empty())
     return nullptr;
   return composition_.back().GetSelectedCandidate();
@@ -71,7 +80,7 @@ bool Context::PushInput(char ch) {
     input_.insert(caret_pos_, 1, ch);
     ++caret_pos_;
   }
-  update_notifier_(this);
+  NotifyUpdate();
   return true;
 }
 
@@ -83,7 +92,7 @@ bool Context::PushInput(const string& str) {
     input_.insert(caret_pos_, str);
     caret_pos_ += str.length();
   }
-  update_notifier_(this);
+  NotifyUpdate();
   return true;
 }
 
@@ -92,7 +101,7 @@ bool Context::PopInput(size_t len) {
     return false;
   caret_pos_ -= len;
   input_.erase(caret_pos_, len);
-  update_notifier_(this);
+  NotifyUpdate();
   return true;
 }
 
@@ -100,7 +109,7 @@ bool Context::DeleteInput(size_t len) {
   if (caret_pos_ + len > input_.length())
     return false;
   input_.erase(caret_pos_, len);
-  update_notifier_(this);
+  NotifyUpdate();
   return true;
 }
 
@@ -108,10 +117,11 @@ void Context::Clear() {
   input_.clear();
   caret_pos_ = 0;
   composition_.clear();
-  update_notifier_(this);
+  NotifyUpdate();
 }
 
 bool Context::Select(size_t index) {
+  ComposeIfOutdated();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -126,6 +136,7 @@ bool Context::Select(size_t index) {
 }
 
 bool Context::Highlight(size_t index) {
+  ComposeIfOutdated();
   if (composition_.empty() || !composition_.back().menu)
     return false;
   Segment& seg(composition_.back());
@@ -141,7 +152,7 @@ bool Context::Highlight(size_t index) {
     return false;
   }
   seg.selected_index = new_index;
-  update_notifier_(this);
+  NotifyUpdate();
   DLOG(INFO) << "selection changed from: " << previous_index
              << " to: " << new_index;
   return true;
@@ -149,6 +160,7 @@ bool Context::Highlight(size_t index) {
 
 bool Context::DeleteCandidate(
     function<an<Candidate>(Segment& seg)> get_candidate) {
+  ComposeIfOutdated();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -171,6 +183,7 @@ bool Context::DeleteCurrentSelection() {
 }
 
 bool Context::ConfirmCurrentSelection() {
+  ComposeIfOutdated();
   if (composition_.empty())
     return false;
   Segment& seg(composition_.back());
@@ -189,7 +202,21 @@ bool Context::ConfirmCurrentSelection() {
   return true;
 }
 
+static bool is_selected(const Segment& seg) {
+  return seg.status >= Segment::kSelected;
+}
+
+bool Context::HasSelectedSegment() const {
+  if (std::none_of(composition_.begin(), composition_.end(), is_selected))
+    return false;
+  // segments selected before the input was edited may be gone
+  ComposeIfOutdated();
+  return std::any_of(composition_.begin(), composition_.end(), is_selected);
+}
+
 void Context::BeginEditing() {
+  if (!HasSelectedSegment())
+    return;
   for (auto it = composition_.rbegin(); it != composition_.rend(); ++it) {
     if (it->status > Segment::kSelected) {
       return;
@@ -207,18 +234,20 @@ bool Context::ConfirmPreviousSelection() {
 }
 
 bool Context::ReopenPreviousSegment() {
+  ComposeIfOutdated();
   if (composition_.Trim()) {
     if (!composition_.empty() &&
         composition_.back().status >= Segment::kSelected) {
       composition_.back().Reopen(caret_pos());
     }
-    update_notifier_(this);
+    NotifyUpdate();
     return true;
   }
   return false;
 }
 
 bool Context::ClearPreviousSegment() {
+  ComposeIfOutdated();
   if (composition_.empty())
     return false;
   size_t where = composition_.back().start;
@@ -229,6 +258,7 @@ bool Context::ClearPreviousSegment() {
 }
 
 bool Context::ReopenPreviousSelection() {
+  ComposeIfOutdated();
   for (auto it = composition_.rbegin(); it != composition_.rend(); ++it) {
     if (it->status > Segment::kSelected)
       return false;
@@ -241,7 +271,7 @@ bool Context::ReopenPreviousSelection() {
         composition_.pop_back();
       }
       it->Reopen(caret_pos());
-      update_notifier_(this);
+      NotifyUpdate();
       return true;
     }
   }
@@ -249,6 +279,7 @@ bool Context::ReopenPreviousSelection() {
 }
 
 bool Context::ClearNonConfirmedComposition() {
+  ComposeIfOutdated();
   bool reverted = false;
   while (!composition_.empty() &&
          composition_.back().status < Segment::kSelected) {
@@ -264,7 +295,7 @@ bool Context::ClearNonConfirmedComposition() {
 
 bool Context::RefreshNonConfirmedComposition() {
   if (ClearNonConfirmedComposition()) {
-    update_notifier_(this);
+    NotifyUpdate();
     return true;
   }
   return false;
@@ -275,17 +306,41 @@ void Context::set_caret_pos(size_t caret_pos) {
     caret_pos_ = input_.length();
   else
     caret_pos_ = caret_pos;
-  update_notifier_(this);
+  NotifyUpdate();
 }
 
 void Context::set_composition(Composition&& comp) {
+  // or the pending update would overwrite it
+  ComposeIfOutdated();
   composition_ = std::move(comp);
 }
 
+void Context::NotifyUpdate() {
+  if (lazy_composition_)
+    composition_outdated_ = true;
+  else
+    compose_notifier_(this);
+  update_notifier_(this);
+}
+
+void Context::ComposeOutdated() const {
+  composition_outdated_ = false;
+  // the composition is a cache of the input, so composing it is a logical
+  // read of the context
+  auto* self = const_cast<Context*>(this);
+  self->compose_notifier_(self);
+}
+
+void Context::set_lazy_composition(bool lazy) {
+  lazy_composition_ = lazy;
+  if (!lazy)
+    ComposeIfOutdated();
+}
+
 void Context::set_input(const string& value) {
   input_ = value;
   caret_pos_ = input_.length();
-  update_notifier_(this);
+  NotifyUpdate();
 }
 
 void Context::set_option(const string& name, bool value) {
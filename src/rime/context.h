@@ -34,6 +34,9 @@ class RIME_API Context {
   Preedit GetPreedit() const;
   bool IsComposing() const;
   bool HasMenu() const;
+  // known without composing an outdated composition if no segment has been
+  // selected, as composing never selects a segment.
+  bool HasSelectedSegment() const;
   an<Candidate> GetSelectedCandidate() const;
 
   bool PushInput(char ch);
@@ -65,8 +68,14 @@ class RIME_API Context {
   size_t caret_pos() const { return caret_pos_; }
 
   void set_composition(Composition&& comp);
-  Composition& composition() { return composition_; }
-  const Composition& composition() const { return composition_; }
+  Composition& composition() {
+    ComposeIfOutdated();
+    return composition_;
+  }
+  const Composition& composition() const {
+    ComposeIfOutdated();
+    return composition_;
+  }
   CommitHistory& commit_history() { return commit_history_; }
   const CommitHistory& commit_history() const { return commit_history_; }
 
@@ -78,8 +87,15 @@ class RIME_API Context {
   // others are session scoped.
   void ClearTransientOptions();
 
+  // in lazy composition, edits only mark the composition as outdated; it is
+  // composed when next read, or when lazy composition is turned off.
+  void set_lazy_composition(bool lazy);
+  bool lazy_composition() const { return lazy_composition_; }
+
   Notifier& commit_notifier() { return commit_notifier_; }
   Notifier& select_notifier() { return select_notifier_; }
+  // asks the engine to compose the updated input
+  Notifier& compose_notifier() { return compose_notifier_; }
   Notifier& update_notifier() { return update_notifier_; }
   Notifier& delete_notifier() { return delete_notifier_; }
   OptionUpdateNotifier& option_update_notifier() {
@@ -93,16 +109,25 @@ class RIME_API Context {
  private:
   string GetSoftCursor() const;
   bool DeleteCandidate(function<an<Candidate>(Segment& seg)> get_candidate);
+  void NotifyUpdate();
+  void ComposeIfOutdated() const {
+    if (composition_outdated_)
+      ComposeOutdated();
+  }
+  void ComposeOutdated() const;
 
   string input_;
   size_t caret_pos_ = 0;
   Composition composition_;
+  bool lazy_composition_ = false;
+  mutable bool composition_outdated_ = false;
   CommitHistory commit_history_;
   map<string, bool> options_;
   map<string, string> properties_;
 
   Notifier commit_notifier_;
   Notifier select_notifier_;
+  Notifier compose_notifier_;
   Notifier update_notifier_;
   Notifier delete_notifier_;
   OptionUpdateNotifier option_update_notifier_;
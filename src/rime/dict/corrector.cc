@@ -17,6 +17,12 @@
 #include "TargetConditionals.h"
 #endif
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace rime;
 using namespace corrector;
 
@@ -139,6 +145,8 @@ void EditDistanceCorrector::ToleranceSearch(const Prism& prism,
   size_t key_len = key.length();
 
   vector<size_t> jump_pos(key_len);
+  // spellings to correct to, with the length of input they replace
+  vector<std::pair<string, size_t>> candidates;
 
   auto match_next = [&](size_t& node, size_t& point) -> bool {
     auto res_val = trie_->traverse(key.c_str(), node, point, point + 1);
@@ -147,18 +155,11 @@ void EditDistanceCorrector::ToleranceSearch(const Prism& prism,
     if (res_val >= 0) {
       for (auto accessor = QuerySpelling(res_val); !accessor.exhausted();
            accessor.Next()) {
-        auto origin = accessor.properties().tips;
-        auto current_input = key.substr(0, point);
-        if (origin == current_input) {
+        const auto& origin = accessor.properties().tips;
+        if (key.compare(0, point, origin) == 0) {
           continue;  // early termination: this comparison is O(n)
         }
-        auto distance = RestrictedDistance(origin, current_input, threshold);
-        if (distance <= threshold) {  // only trace near words
-          SyllableId corrected;
-          if (prism.GetValue(origin, &corrected)) {
-            results->Alter(corrected, {distance, corrected, point});
-          }
-        }
+        candidates.emplace_back(origin, point);
       }
     }
     return true;
@@ -180,17 +181,256 @@ void EditDistanceCorrector::ToleranceSearch(const Prism& prism,
         break;
     }
   }
+
+  if (candidates.empty())
+    return;
+  // every edit costs at least 1 in RestrictedDistance, and an insertion or
+  // deletion costs 2, so the unit-cost distance computed in one bit-parallel
+  // pass per spelling rules out most candidates before the weighted DP.
+  const bool filter = key_len <= BitParallelDistance::kMaxPatternLength;
+  hash_map<string, size_t> origin_index;
+  vector<const string*> origins;
+  vector<Distance> prefix_distances;
+  if (filter) {
+    for (const auto& c : candidates) {
+      if (origin_index.emplace(c.first, origins.size()).second) {
+        origins.push_back(&c.first);
+      }
+    }
+    BitParallelDistance(key).BatchPrefixDistances(origins, &prefix_distances);
+  }
+  for (const auto& c : candidates) {
+    const string& origin = c.first;
+    size_t point = c.second;
+    if (filter) {
+      size_t row = origin_index[origin] * (key_len + 1);
+      size_t length_difference = point > origin.length()
+                                     ? point - origin.length()
+                                     : origin.length() - point;
+      Distance lower_bound = (std::max)(prefix_distances[row + point],
+                                        Distance(2 * length_difference));
+      if (lower_bound > threshold)
+        continue;
+    }
+    auto distance = RestrictedDistance(origin, key.substr(0, point), threshold);
+    if (distance <= threshold) {  // only trace near words
+      SyllableId corrected;
+      if (prism.GetValue(origin, &corrected)) {
+        results->Alter(corrected, {distance, corrected, point});
+      }
+    }
+  }
 }
 
+namespace {
+
+// keyboard_map as a lookup table, which is also safe to read concurrently
+struct NeighborKeys {
+  bool is_neighbor[256][256] = {};
+
+  NeighborKeys() {
+    for (const auto& k : keyboard_map) {
+      for (char n : k.second) {
+        is_neighbor[(uint8_t)k.first][(uint8_t)n] = true;
+      }
+    }
+  }
+};
+
+const NeighborKeys& neighbor_keys() {
+  static const NeighborKeys table;
+  return table;
+}
+
+}  // namespace
+
 inline uint8_t SubstCost(char left, char right) {
   if (left == right)
     return 0;
-  if (keyboard_map[left].find(right) != keyboard_map[left].end()) {
+  if (neighbor_keys().is_neighbor[(uint8_t)left][(uint8_t)right]) {
     return 1;
   }
   return 4;
 }
 
+// Bit-parallel restricted edit distance after H. Hyyrö, "A bit-vector
+// algorithm for computing Levenshtein and Damerau edit distances" (2003).
+// Bit i of the vectors stands for row i + 1 of the DP matrix, whose rows
+// are the pattern and columns the text.
+
+namespace {
+
+struct ScalarLanes {
+  using V = uint64_t;
+  static constexpr size_t kWidth = 1;
+  static V Load(const uint64_t* p) { return *p; }
+  static void Store(uint64_t* p, V v) { *p = v; }
+  static V Zero() { return 0; }
+  static V One() { return 1; }
+  static V Ones() { return ~uint64_t(0); }
+  static V And(V a, V b) { return a & b; }
+  static V Or(V a, V b) { return a | b; }
+  static V Xor(V a, V b) { return a ^ b; }
+  // ~a & b
+  static V AndNot(V a, V b) { return ~a & b; }
+  static V Add(V a, V b) { return a + b; }
+  static V ShiftLeft1(V a) { return a << 1; }
+};
+
+#if defined(__AVX2__)
+struct SimdLanes {
+  using V = __m256i;
+  static constexpr size_t kWidth = 4;
+  static V Load(const uint64_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void Store(uint64_t* p, V v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+  }
+  static V Zero() { return _mm256_setzero_si256(); }
+  static V One() { return _mm256_set1_epi64x(1); }
+  static V Ones() { return _mm256_set1_epi64x(-1); }
+  static V And(V a, V b) { return _mm256_and_si256(a, b); }
+  static V Or(V a, V b) { return _mm256_or_si256(a, b); }
+  static V Xor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V AndNot(V a, V b) { return _mm256_andnot_si256(a, b); }
+  static V Add(V a, V b) { return _mm256_add_epi64(a, b); }
+  static V ShiftLeft1(V a) { return _mm256_slli_epi64(a, 1); }
+};
+#elif defined(__SSE2__)
+struct SimdLanes {
+  using V = __m128i;
+  static constexpr size_t kWidth = 2;
+  static V Load(const uint64_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  static void Store(uint64_t* p, V v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+  static V Zero() { return _mm_setzero_si128(); }
+  static V One() { return _mm_set_epi32(0, 1, 0, 1); }
+  static V Ones() { return _mm_set1_epi32(-1); }
+  static V And(V a, V b) { return _mm_and_si128(a, b); }
+  static V Or(V a, V b) { return _mm_or_si128(a, b); }
+  static V Xor(V a, V b) { return _mm_xor_si128(a, b); }
+  static V AndNot(V a, V b) { return _mm_andnot_si128(a, b); }
+  static V Add(V a, V b) { return _mm_add_epi64(a, b); }
+  static V ShiftLeft1(V a) { return _mm_slli_epi64(a, 1); }
+};
+#else
+using SimdLanes = ScalarLanes;
+#endif
+
+// scans up to L::kWidth texts side by side, leaving the vertical deltas of
+// the last column of each text in vp and vn.
+template <class L>
+void scan_columns(const uint64_t* peq,
+                  const string* const* texts,
+                  size_t num_texts,
+                  uint64_t* vp,
+                  uint64_t* vn) {
+  size_t max_length = 0;
+  for (size_t k = 0; k < num_texts; ++k) {
+    max_length = (std::max)(max_length, texts[k]->length());
+  }
+  uint64_t lane_eq[L::kWidth];
+  uint64_t lane_active[L::kWidth];
+  const typename L::V ones = L::Ones();
+  const typename L::V one = L::One();
+  typename L::V pv = ones;
+  typename L::V mv = L::Zero();
+  typename L::V d0 = L::Zero();
+  typename L::V prev_eq = L::Zero();
+  for (size_t j = 0; j < max_length; ++j) {
+    for (size_t k = 0; k < L::kWidth; ++k) {
+      bool active = k < num_texts && j < texts[k]->length();
+      lane_eq[k] = active ? peq[(uint8_t)(*texts[k])[j]] : 0;
+      lane_active[k] = active ? ~uint64_t(0) : 0;
+    }
+    const auto eq = L::Load(lane_eq);
+    const auto active = L::Load(lane_active);
+    // transposition of the previous and the current characters
+    const auto tr = L::And(L::ShiftLeft1(L::AndNot(d0, eq)), prev_eq);
+    const auto next_d0 = L::Or(
+        L::Or(L::Xor(L::Add(L::And(eq, pv), pv), pv), L::Or(eq, mv)), tr);
+    const auto hp = L::Or(mv, L::AndNot(L::Or(next_d0, pv), ones));
+    const auto hn = L::And(pv, next_d0);
+    // the first row grows by one in each column
+    const auto x = L::Or(L::ShiftLeft1(hp), one);
+    const auto next_mv = L::And(x, next_d0);
+    const auto next_pv =
+        L::Or(L::ShiftLeft1(hn), L::AndNot(L::Or(x, next_d0), ones));
+    // lanes past the end of their texts keep the last column
+    pv = L::Or(L::And(active, next_pv), L::AndNot(active, pv));
+    mv = L::Or(L::And(active, next_mv), L::AndNot(active, mv));
+    d0 = L::Or(L::And(active, next_d0), L::AndNot(active, d0));
+    prev_eq = eq;
+  }
+  uint64_t lane_pv[L::kWidth];
+  uint64_t lane_mv[L::kWidth];
+  L::Store(lane_pv, pv);
+  L::Store(lane_mv, mv);
+  for (size_t k = 0; k < num_texts; ++k) {
+    vp[k] = lane_pv[k];
+    vn[k] = lane_mv[k];
+  }
+}
+
+void fill_prefix_distances(size_t pattern_length,
+                           size_t text_length,
+                           uint64_t vp,
+                           uint64_t vn,
+                           Distance* distances) {
+  // the first row of the DP matrix ends with the text length
+  Distance d = text_length;
+  distances[0] = d;
+  for (size_t i = 0; i < pattern_length; ++i) {
+    d = d + ((vp >> i) & 1) - ((vn >> i) & 1);
+    distances[i + 1] = d;
+  }
+}
+
+}  // namespace
+
+BitParallelDistance::BitParallelDistance(const string& pattern)
+    : length_((std::min)(pattern.length(), kMaxPatternLength)) {
+  std::fill(std::begin(peq_), std::end(peq_), 0);
+  for (size_t i = 0; i < length_; ++i) {
+    peq_[(uint8_t)pattern[i]] |= uint64_t(1) << i;
+  }
+}
+
+void BitParallelDistance::PrefixDistances(const string& text,
+                                          Distance* distances) const {
+  const string* texts[] = {&text};
+  uint64_t vp, vn;
+  scan_columns<ScalarLanes>(peq_, texts, 1, &vp, &vn);
+  fill_prefix_distances(length_, text.length(), vp, vn, distances);
+}
+
+Distance BitParallelDistance::operator()(const string& text) const {
+  Distance distances[kMaxPatternLength + 1];
+  PrefixDistances(text, distances);
+  return distances[length_];
+}
+
+void BitParallelDistance::BatchPrefixDistances(
+    const vector<const string*>& texts,
+    vector<Distance>* distances) const {
+  const size_t row = length_ + 1;
+  distances->resize(texts.size() * row);
+  uint64_t vp[SimdLanes::kWidth];
+  uint64_t vn[SimdLanes::kWidth];
+  for (size_t i = 0; i < texts.size(); i += SimdLanes::kWidth) {
+    size_t n = (std::min)(SimdLanes::kWidth, texts.size() - i);
+    scan_columns<SimdLanes>(peq_, &texts[i], n, vp, vn);
+    for (size_t k = 0; k < n; ++k) {
+      fill_prefix_distances(length_, texts[i + k]->length(), vp[k], vn[k],
+                            &(*distances)[(i + k) * row]);
+    }
+  }
+}
+
 // This nice O(min(m, n)) implementation is from
 // https://en.wikibooks.org/wiki/Algorithm_Implementation/Strings/Levenshtein_distance#C++
 Distance EditDistanceCorrector::LevenshteinDistance(const std::string& s1,
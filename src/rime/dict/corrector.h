@@ -48,6 +48,32 @@ class Corrections : public hash_map<SyllableId, Correction> {
     }
   };
 };
+
+/// Unit-cost restricted edit distance (optimal string alignment) between
+/// a pattern of up to 64 bytes and any text, computed with Hyyrö's
+/// bit-parallel algorithm. One pass over the text yields the distances from
+/// every prefix of the pattern.
+class RIME_API BitParallelDistance {
+ public:
+  static constexpr size_t kMaxPatternLength = 64;
+
+  explicit BitParallelDistance(const string& pattern);
+
+  size_t pattern_length() const { return length_; }
+
+  /// \param distances receives pattern_length() + 1 values, the distance
+  /// from pattern[0, i) to text at index i.
+  void PrefixDistances(const string& text, Distance* distances) const;
+  Distance operator()(const string& text) const;
+  /// Same as PrefixDistances, scoring several texts at once on SIMD lanes
+  /// where available. distances are stored text by text.
+  void BatchPrefixDistances(const vector<const string*>& texts,
+                            vector<Distance>* distances) const;
+
+ private:
+  uint64_t peq_[256];
+  size_t length_;
+};
 }  // namespace corrector
 
 /**
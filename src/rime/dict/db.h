@@ -63,6 +63,8 @@ class Db : public Class<Db, const string&> {
   bool disabled() const { return disabled_; }
   void disable() { disabled_ = true; }
   void enable() { disabled_ = false; }
+  // whether values can hold arbitrary bytes.
+  virtual bool binary_safe() const { return false; }
 
  protected:
   string name_;
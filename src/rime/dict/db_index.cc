@@ -0,0 +1,208 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <rime/dict/db_index.h>
+#include <rime/dict/user_db.h>
+
+namespace rime {
+
+// PendingUpdatesAccessor members
+
+PendingUpdatesAccessor::PendingUpdatesAccessor(
+    an<DbAccessor> base,
+    const map<string, string>& pending_updates,
+    const string& prefix)
+    : DbAccessor(prefix), base_(base), pending_updates_(pending_updates) {
+  Reset();
+}
+
+PendingUpdatesAccessor::PendingUpdatesAccessor(
+    an<DbAccessor> base,
+    map<string, string>&& pending_updates,
+    const string& prefix)
+    : DbAccessor(prefix),
+      base_(base),
+      own_updates_(std::move(pending_updates)),
+      pending_updates_(own_updates_) {
+  Reset();
+}
+
+bool PendingUpdatesAccessor::Reset() {
+  bool ok = base_->Reset();
+  iter_ = pending_updates_.lower_bound(prefix_);
+  FetchBaseRecord();
+  return ok || HasPendingRecord();
+}
+
+bool PendingUpdatesAccessor::Jump(const string& key) {
+  bool ok = base_->Jump(key);
+  iter_ = pending_updates_.lower_bound(key);
+  FetchBaseRecord();
+  return ok || HasPendingRecord();
+}
+
+bool PendingUpdatesAccessor::GetNextRecord(string* key, string* value) {
+  if (!key || !value)
+    return false;
+  bool has_pending_record = HasPendingRecord();
+  if (has_pending_record && (!has_base_record_ || iter_->first <= base_key_)) {
+    // a pending update overrides the record in db
+    if (has_base_record_ && iter_->first == base_key_)
+      FetchBaseRecord();
+    *key = iter_->first;
+    *value = iter_->second;
+    ++iter_;
+    return true;
+  }
+  if (!has_base_record_)
+    return false;
+  key->swap(base_key_);
+  value->swap(base_value_);
+  FetchBaseRecord();
+  return true;
+}
+
+bool PendingUpdatesAccessor::exhausted() {
+  return !has_base_record_ && !HasPendingRecord();
+}
+
+bool PendingUpdatesAccessor::HasPendingRecord() {
+  return iter_ != pending_updates_.end() && MatchesPrefix(iter_->first);
+}
+
+void PendingUpdatesAccessor::FetchBaseRecord() {
+  has_base_record_ = base_->GetNextRecord(&base_key_, &base_value_);
+}
+
+// DbIndexAccessor members
+
+DbIndexAccessor::DbIndexAccessor(const DbIndex& index, const string& prefix)
+    : DbAccessor(prefix), index_(index) {
+  Reset();
+}
+
+bool DbIndexAccessor::Reset() {
+  pos_ = index_.LowerBound(prefix_);
+  return pos_ < index_.records_.size();
+}
+
+bool DbIndexAccessor::Jump(const string& key) {
+  pos_ = index_.LowerBound(key);
+  return pos_ < index_.records_.size();
+}
+
+bool DbIndexAccessor::GetNextRecord(string* key, string* value) {
+  if (!key || !value || exhausted())
+    return false;
+  auto k = index_.key(pos_);
+  auto v = index_.value(pos_);
+  key->assign(k.data(), k.size());
+  value->assign(v.data(), v.size());
+  ++pos_;
+  return true;
+}
+
+bool DbIndexAccessor::exhausted() {
+  if (pos_ >= index_.records_.size())
+    return true;
+  auto k = index_.key(pos_);
+  return k.compare(0, prefix_.length(), prefix_) != 0;
+}
+
+// DbIndex members
+
+bool DbIndex::Build(Db* db) {
+  generation_ = UserDb::generation();
+  data_.clear();
+  records_.clear();
+  delta_.clear();
+  loaded_ = false;
+  if (!db || !db->loaded())
+    return false;
+  auto accessor = db->QueryAll();
+  if (!accessor)
+    return false;
+  string key, value;
+  while (accessor->GetNextRecord(&key, &value)) {
+    Append(key, value);
+  }
+  data_.shrink_to_fit();
+  records_.shrink_to_fit();
+  loaded_ = true;
+  LOG(INFO) << "indexed " << records_.size() << " records of db '"
+            << db->name() << "'.";
+  return true;
+}
+
+void DbIndex::Update(const string& key, const string& value) {
+  delta_[key] = value;
+  if (delta_.size() >= kMaxDeltaSize)
+    Merge();
+}
+
+an<DbAccessor> DbIndex::Query(const string& prefix) const {
+  auto accessor = New<DbIndexAccessor>(*this, prefix);
+  if (delta_.empty())
+    return accessor;
+  return New<PendingUpdatesAccessor>(accessor, delta_, prefix);
+}
+
+bool DbIndex::Fetch(const string& k, string* v) const {
+  auto found = delta_.find(k);
+  if (found != delta_.end()) {
+    *v = found->second;
+    return true;
+  }
+  size_t i = LowerBound(k);
+  if (i == records_.size() || key(i) != k)
+    return false;
+  auto found_value = value(i);
+  v->assign(found_value.data(), found_value.size());
+  return true;
+}
+
+size_t DbIndex::LowerBound(std::string_view k) const {
+  size_t lo = 0, hi = records_.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (key(mid) < k)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+void DbIndex::Append(std::string_view k, std::string_view v) {
+  records_.push_back({static_cast<uint32_t>(data_.size()),
+                      static_cast<uint32_t>(k.size()),
+                      static_cast<uint32_t>(v.size())});
+  data_.append(k.data(), k.size());
+  data_.append(v.data(), v.size());
+}
+
+void DbIndex::Merge() {
+  DbIndex merged;
+  merged.data_.reserve(data_.size());
+  merged.records_.reserve(records_.size() + delta_.size());
+  size_t i = 0;
+  auto d = delta_.begin();
+  while (i < records_.size() || d != delta_.end()) {
+    if (d == delta_.end() || (i < records_.size() && key(i) < d->first)) {
+      merged.Append(key(i), value(i));
+      ++i;
+    } else {
+      if (i < records_.size() && key(i) == d->first)
+        ++i;  // updated
+      merged.Append(d->first, d->second);
+      ++d;
+    }
+  }
+  data_.swap(merged.data_);
+  records_.swap(merged.records_);
+  delta_.clear();
+}
+
+}  // namespace rime
@@ -0,0 +1,113 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_DB_INDEX_H_
+#define RIME_DB_INDEX_H_
+
+#include <string_view>
+#include <rime/common.h>
+#include <rime/dict/db.h>
+
+namespace rime {
+
+// merges updates not yet written to db into the records of another accessor.
+class PendingUpdatesAccessor : public DbAccessor {
+ public:
+  // updates must outlive the accessor.
+  PendingUpdatesAccessor(an<DbAccessor> base,
+                         const map<string, string>& pending_updates,
+                         const string& prefix);
+  // takes a copy of the updates.
+  PendingUpdatesAccessor(an<DbAccessor> base,
+                         map<string, string>&& pending_updates,
+                         const string& prefix);
+
+  bool Reset() override;
+  bool Jump(const string& key) override;
+  bool GetNextRecord(string* key, string* value) override;
+  bool exhausted() override;
+
+ private:
+  bool HasPendingRecord();
+  void FetchBaseRecord();
+
+  an<DbAccessor> base_;
+  map<string, string> own_updates_;
+  const map<string, string>& pending_updates_;
+  map<string, string>::const_iterator iter_;
+  bool has_base_record_ = false;
+  string base_key_;
+  string base_value_;
+};
+
+class DbIndex;
+
+class DbIndexAccessor : public DbAccessor {
+ public:
+  DbIndexAccessor(const DbIndex& index, const string& prefix);
+
+  bool Reset() override;
+  bool Jump(const string& key) override;
+  bool GetNextRecord(string* key, string* value) override;
+  bool exhausted() override;
+
+ private:
+  const DbIndex& index_;
+  size_t pos_ = 0;
+};
+
+// a sorted copy of the records of a db in memory, searched by binary search.
+// updates are kept in a small delta until there are enough of them to merge.
+class DbIndex {
+ public:
+  static constexpr size_t kMaxDeltaSize = 1024;
+
+  DbIndex() = default;
+
+  // loads all records but metadata from db.
+  RIME_API bool Build(Db* db);
+  RIME_API void Update(const string& key, const string& value);
+  // accessors are invalidated by Build() and Update().
+  RIME_API an<DbAccessor> Query(const string& prefix) const;
+  RIME_API bool Fetch(const string& key, string* value) const;
+
+  bool loaded() const { return loaded_; }
+  // of user dbs when built
+  uint64_t generation() const { return generation_; }
+  size_t size() const { return records_.size() + delta_.size(); }
+
+ private:
+  friend class DbIndexAccessor;
+
+  struct Record {
+    uint32_t key_offset;
+    uint32_t key_length;
+    // the value follows the key
+    uint32_t value_length;
+  };
+
+  std::string_view key(size_t i) const {
+    const auto& r = records_[i];
+    return std::string_view(data_.data() + r.key_offset, r.key_length);
+  }
+  std::string_view value(size_t i) const {
+    const auto& r = records_[i];
+    return std::string_view(data_.data() + r.key_offset + r.key_length,
+                            r.value_length);
+  }
+  size_t LowerBound(std::string_view key) const;
+  void Append(std::string_view key, std::string_view value);
+  void Merge();
+
+  // keys and values
+  string data_;
+  vector<Record> records_;
+  map<string, string> delta_;
+  bool loaded_ = false;
+  uint64_t generation_ = 0;
+};
+
+}  // namespace rime
+
+#endif  // RIME_DB_INDEX_H_
@@ -15,6 +15,7 @@
 #include <rime/dict/dict_settings.h>
 #include <rime/dict/dictionary.h>
 #include <rime/dict/entry_collector.h>
+#include <rime/dict/external_vocabulary.h>
 #include <rime/dict/preset_vocabulary.h>
 #include <rime/dict/prism.h>
 #include <rime/dict/reverse_lookup_dictionary.h>
@@ -29,6 +30,7 @@ DictCompiler::DictCompiler(Dictionary* dictionary)
       packs_(dictionary->packs()),
       prism_(dictionary->prism()),
       tables_(dictionary->tables()),
+      table_format_version_(Table::kDefaultFormatVersion),
       source_resolver_(
           Service::instance().CreateResourceResolver({"source_file", "", ""})),
       target_resolver_(Service::instance().CreateStagingResourceResolver(
@@ -61,22 +63,44 @@ static bool get_dict_files_from_settings(vector<path>* dict_files,
   return true;
 }
 
+// combines checksums of each source file, which are recorded in the table.
 static uint32_t compute_dict_file_checksum(uint32_t initial_checksum,
                                            const vector<path>& dict_files,
-                                           DictSettings& settings) {
+                                           DictSettings& settings,
+                                           TableSources* sources) {
   if (dict_files.empty()) {
     return initial_checksum;
   }
-  ChecksumComputer cc(initial_checksum);
-  for (const auto& file_path : dict_files) {
-    cc.ProcessFile(file_path);
-  }
+  vector<path> source_files(dict_files);
   if (settings.use_preset_vocabulary()) {
-    cc.ProcessFile(PresetVocabulary::DictFilePath(settings.vocabulary()));
+    source_files.push_back(
+        PresetVocabulary::DictFilePath(settings.vocabulary()));
+  }
+  ChecksumComputer cc(initial_checksum);
+  for (const auto& file_path : source_files) {
+    uint32_t checksum = Checksum(file_path);
+    sources->emplace_back(file_path.filename().u8string(), checksum);
+    cc.ProcessBytes(&checksum, sizeof(checksum));
   }
   return cc.Checksum();
 }
 
+static void log_changed_sources(const Table& table,
+                                const TableSources& sources) {
+  map<string, uint32_t> recorded;
+  for (const auto& source : table.GetSources()) {
+    recorded.insert(source);
+  }
+  for (const auto& source : sources) {
+    auto found = recorded.find(source.first);
+    if (found == recorded.end()) {
+      LOG(INFO) << "new source file: " << source.first;
+    } else if (found->second != source.second) {
+      LOG(INFO) << "changed source file: " << source.first;
+    }
+  }
+}
+
 bool DictCompiler::Compile(const path& schema_file) {
   LOG(INFO) << "compiling dictionary for " << schema_file;
   bool build_table_from_source = true;
@@ -94,8 +118,9 @@ bool DictCompiler::Compile(const path& schema_file) {
                                     source_resolver_.get())) {
     return false;
   }
+  TableSources sources;
   uint32_t dict_file_checksum =
-      compute_dict_file_checksum(0, dict_files, settings);
+      compute_dict_file_checksum(0, dict_files, settings, &sources);
   uint32_t schema_file_checksum =
       schema_file.empty() ? 0 : Checksum(schema_file);
   bool rebuild_table = false;
@@ -104,6 +129,12 @@ bool DictCompiler::Compile(const path& schema_file) {
   if (primary_table->Exists() && primary_table->Load()) {
     if (build_table_from_source) {
       rebuild_table = primary_table->dict_file_checksum() != dict_file_checksum;
+      if (rebuild_table) {
+        log_changed_sources(*primary_table, sources);
+      } else if (primary_table->format_version() != table_format_version_) {
+        LOG(INFO) << "table format changed to v" << table_format_version_;
+        rebuild_table = true;
+      }
     } else {
       dict_file_checksum = primary_table->dict_file_checksum();
       LOG(INFO) << "reuse existing table: " << primary_table->file_path();
@@ -116,13 +147,6 @@ bool DictCompiler::Compile(const path& schema_file) {
                << ".table.bin exists.";
     return false;
   }
-  if (prism_->Exists() && prism_->Load()) {
-    rebuild_prism = prism_->dict_file_checksum() != dict_file_checksum ||
-                    prism_->schema_file_checksum() != schema_file_checksum;
-    prism_->Close();
-  } else {
-    rebuild_prism = true;
-  }
   LOG(INFO) << dict_file << "[" << dict_files.size() << " file(s)]"
             << " (" << dict_file_checksum << ")";
   LOG(INFO) << schema_file << " (" << schema_file_checksum << ")";
@@ -139,24 +163,43 @@ bool DictCompiler::Compile(const path& schema_file) {
   if (build_table_from_source && (options_ & kRebuildTable)) {
     rebuild_table = true;
   }
-  if (options_ & kRebuildPrism) {
-    rebuild_prism = true;
-  }
   Syllabary syllabary;
   if (rebuild_table) {
     EntryCollector collector;
-    if (!BuildTable(0, collector, &settings, dict_files, dict_file_checksum)) {
+    if (!BuildTable(0, collector, &settings, dict_files, dict_file_checksum,
+                    sources)) {
       return false;
     }
     syllabary = std::move(collector.syllabary);
-  } else if (packs_.size() > 0) {
-    if (primary_table->Load() && primary_table->GetSyllabary(&syllabary))
-      primary_table->Close();
-    else
+  }
+  // the prism and packs depend on the syllabary of the primary table, which
+  // may stay the same when the table is rebuilt.
+  uint32_t syllabary_checksum = 0;
+  if (primary_table->Load()) {
+    syllabary_checksum = primary_table->syllabary_checksum();
+    if (!rebuild_table && packs_.size() > 0 &&
+        !primary_table->GetSyllabary(&syllabary)) {
       LOG(WARNING) << "couldn't load syllabary from '" << schema_file << "'";
+    }
+    primary_table->Close();
+  } else {
+    LOG(WARNING) << "couldn't load primary table '"
+                 << primary_table->file_path() << "'";
+  }
+  LOG(INFO) << "syllabary (" << syllabary_checksum << ")";
+  // a prism records the syllabary checksum as its dict file checksum
+  if (prism_->Exists() && prism_->Load()) {
+    rebuild_prism = prism_->dict_file_checksum() != syllabary_checksum ||
+                    prism_->schema_file_checksum() != schema_file_checksum;
+    prism_->Close();
+  } else {
+    rebuild_prism = true;
+  }
+  if (options_ & kRebuildPrism) {
+    rebuild_prism = true;
   }
   if (rebuild_prism &&
-      !BuildPrism(schema_file, dict_file_checksum, schema_file_checksum)) {
+      !BuildPrism(schema_file, syllabary_checksum, schema_file_checksum)) {
     return false;
   }
   for (int table_index = 1; table_index < tables_.size(); ++table_index) {
@@ -184,16 +227,22 @@ bool DictCompiler::Compile(const path& schema_file) {
                                       source_resolver_.get())) {
       continue;
     }
-    uint32_t pack_file_checksum =
-        compute_dict_file_checksum(dict_file_checksum, dict_files, settings);
+    // a pack is built on the syllabary of the primary table
+    TableSources pack_sources;
+    uint32_t pack_file_checksum = compute_dict_file_checksum(
+        syllabary_checksum, dict_files, settings, &pack_sources);
     bool rebuild_pack = true;
     if (pack_table->Exists() && pack_table->Load()) {
       rebuild_pack = pack_table->dict_file_checksum() != pack_file_checksum;
+      if (rebuild_pack)
+        log_changed_sources(*pack_table, pack_sources);
+      else
+        rebuild_pack = pack_table->format_version() != table_format_version_;
     }
     if (rebuild_pack) {
       LOG(INFO) << "rebuilding pack '" << pack_name << "'";
       if (!BuildTable(table_index, collector, &settings, dict_files,
-                      pack_file_checksum)) {
+                      pack_file_checksum, pack_sources)) {
         LOG(ERROR) << "failed to build pack: " << pack_name;
       }
     } else {
@@ -217,20 +266,27 @@ bool DictCompiler::BuildTable(int table_index,
                               EntryCollector& collector,
                               DictSettings* settings,
                               const vector<path>& dict_files,
-                              uint32_t dict_file_checksum) {
+                              uint32_t dict_file_checksum,
+                              const TableSources& sources) {
   auto& table = tables_[table_index];
   auto target_path =
       relocate_target(table->file_path(), target_resolver_.get());
   LOG(INFO) << "building table: " << target_path;
   table = New<Table>(target_path);
+  table->set_sources(sources);
+  table->set_format_version(table_format_version_);
 
   collector.Configure(settings);
-  collector.Collect(dict_files);
+  collector.Collect(dict_files, parser_pool_);
   if (options_ & kDump) {
     path dump_path(table->file_path());
     dump_path.replace_extension(".txt");
     collector.Dump(dump_path);
   }
+  if (table_memory_limit_ > 0) {
+    return BuildTableInRuns(table_index, collector, settings,
+                            dict_file_checksum);
+  }
   Vocabulary vocabulary;
   // build .table.bin
   {
@@ -277,6 +333,57 @@ bool DictCompiler::BuildTable(int table_index,
   return true;
 }
 
+bool DictCompiler::BuildTableInRuns(int table_index,
+                                    EntryCollector& collector,
+                                    DictSettings* settings,
+                                    uint32_t dict_file_checksum) {
+  auto& table = tables_[table_index];
+  LOG(INFO) << "building table in sorted runs of up to " << table_memory_limit_
+            << " bytes.";
+  ExternalVocabulary vocabulary(table->file_path(), table_memory_limit_,
+                                settings->sort_order() != "original");
+  // syllables of each word, for the reverse db
+  ReverseLookupTable rev_table;
+  map<string, SyllableId> syllable_to_id;
+  SyllableId syllable_id = 0;
+  for (const auto& s : collector.syllabary) {
+    syllable_to_id[s] = syllable_id++;
+  }
+  for (auto& r : collector.entries) {
+    if (r->raw_code.empty()) {
+      LOG(ERROR) << "Error locating entries in vocabulary.";
+      continue;
+    }
+    ShortDictEntry e;
+    for (const auto& s : r->raw_code) {
+      e.code.push_back(syllable_to_id[s]);
+    }
+    if (table_index == 0 && r->raw_code.size() == 1) {
+      rev_table[r->text].insert(r->raw_code[0]);
+    }
+    e.text.swap(r->text);
+    e.weight = log(r->weight > 0 ? r->weight : DBL_EPSILON);
+    // release memory in time to reduce memory usage
+    r.reset();
+    if (!vocabulary.Add(std::move(e)))
+      return false;
+  }
+  vector<of<RawDictEntry>>().swap(collector.entries);
+  table->Remove();
+  if (!vocabulary.Finish() ||
+      !table->Build(collector.syllabary, vocabulary, collector.num_entries,
+                    dict_file_checksum) ||
+      !table->Save()) {
+    return false;
+  }
+  // build reverse db for the primary table
+  if (table_index == 0 &&
+      !BuildReverseDb(settings, collector, rev_table, dict_file_checksum)) {
+    return false;
+  }
+  return true;
+}
+
 bool DictCompiler::BuildReverseDb(DictSettings* settings,
                                   const EntryCollector& collector,
                                   const Vocabulary& vocabulary,
@@ -293,6 +400,21 @@ bool DictCompiler::BuildReverseDb(DictSettings* settings,
   return true;
 }
 
+bool DictCompiler::BuildReverseDb(DictSettings* settings,
+                                  const EntryCollector& collector,
+                                  const ReverseLookupTable& rev_table,
+                                  uint32_t dict_file_checksum) {
+  auto target_path = target_resolver_->ResolvePath(dict_name_ + ".reverse.bin");
+  ReverseDb reverse_db(target_path);
+  if (!reverse_db.Build(settings, rev_table, collector.stems,
+                        dict_file_checksum) ||
+      !reverse_db.Save()) {
+    LOG(ERROR) << "error building reversedb.";
+    return false;
+  }
+  return true;
+}
+
 bool DictCompiler::BuildPrism(const path& schema_file,
                               uint32_t dict_file_checksum,
                               uint32_t schema_file_checksum) {
@@ -9,6 +9,7 @@
 
 #include <rime_api.h>
 #include <rime/common.h>
+#include <rime/dict/vocabulary.h>
 
 namespace rime {
 
@@ -19,8 +20,8 @@ class ReverseDb;
 class DictSettings;
 class EditDistanceCorrector;
 class EntryCollector;
-class Vocabulary;
 class ResourceResolver;
+class WorkerPool;
 
 class DictCompiler {
  public:
@@ -36,13 +37,30 @@ class DictCompiler {
 
   RIME_API bool Compile(const path& schema_file);
   void set_options(int options) { options_ = options; }
+  // builds tables from sorted runs spilled to disk, keeping no more than
+  // the given bytes of entries in memory. 0 builds tables in memory.
+  // entries collected from dict files are held in memory regardless.
+  void set_table_memory_limit(size_t limit) { table_memory_limit_ = limit; }
+  // parses dict files ahead on the pool, which must not be the one running
+  // the compiler.
+  void set_parser_pool(WorkerPool* pool) { parser_pool_ = pool; }
+  // the major version of the table format to build; tables in another
+  // format are rebuilt.
+  void set_table_format_version(int version) {
+    table_format_version_ = version;
+  }
 
  private:
   bool BuildTable(int table_index,
                   EntryCollector& collector,
                   DictSettings* settings,
                   const vector<path>& dict_files,
-                  uint32_t dict_file_checksum);
+                  uint32_t dict_file_checksum,
+                  const TableSources& sources);
+  bool BuildTableInRuns(int table_index,
+                        EntryCollector& collector,
+                        DictSettings* settings,
+                        uint32_t dict_file_checksum);
   bool BuildPrism(const path& schema_file,
                   uint32_t dict_file_checksum,
                   uint32_t schema_file_checksum);
@@ -50,6 +68,10 @@ class DictCompiler {
                       const EntryCollector& collector,
                       const Vocabulary& vocabulary,
                       uint32_t dict_file_checksum);
+  bool BuildReverseDb(DictSettings* settings,
+                      const EntryCollector& collector,
+                      const ReverseLookupTable& rev_table,
+                      uint32_t dict_file_checksum);
 
   const string& dict_name_;
   const vector<string>& packs_;
@@ -57,6 +79,9 @@ class DictCompiler {
   an<EditDistanceCorrector> correction_;
   vector<of<Table>> tables_;
   int options_ = 0;
+  size_t table_memory_limit_ = 0;
+  WorkerPool* parser_pool_ = nullptr;
+  int table_format_version_;
   the<ResourceResolver> source_resolver_;
   the<ResourceResolver> target_resolver_;
 };
@@ -4,6 +4,7 @@
 //
 // 2011-07-05 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <cfloat>
 #include <filesystem>
 #include <rime/algo/syllabifier.h>
@@ -24,7 +25,7 @@ namespace dictionary {
 struct Chunk {
   Table* table = nullptr;
   Code code;
-  const table::Entry* entries = nullptr;
+  table::EntryView entries;
   size_t size = 0;
   size_t cursor = 0;
   string remaining_code;  // for predictive queries
@@ -34,7 +35,7 @@ struct Chunk {
   Chunk() = default;
   Chunk(Table* t,
         const Code& c,
-        const table::Entry* e,
+        const table::EntryView& e,
         size_t m,
         double cr = 0.0)
       : table(t),
@@ -49,7 +50,7 @@ struct Chunk {
   Chunk(Table* t, const TableAccessor& a, const string& r, double cr = 0.0)
       : table(t),
         code(a.index_code()),
-        entries(a.entry()),
+        entries(a.entries()),
         size(a.remaining()),
         cursor(0),
         remaining_code(r),
@@ -66,16 +67,21 @@ struct QueryResult {
 };
 
 bool compare_chunk_by_head_element(const Chunk& a, const Chunk& b) {
-  if (!a.entries || a.cursor >= a.size)
+  if (a.cursor >= a.size)
     return false;
-  if (!b.entries || b.cursor >= b.size)
+  if (b.cursor >= b.size)
     return true;
   if (a.is_exact_match() != b.is_exact_match())
     return a.is_exact_match() > b.is_exact_match();
   if (a.remaining_code.length() != b.remaining_code.length())
     return a.remaining_code.length() < b.remaining_code.length();
-  return a.credibility + a.entries[a.cursor].weight >
-         b.credibility + b.entries[b.cursor].weight;  // by weight desc
+  return a.credibility + a.entries.weight(a.cursor) >
+         b.credibility + b.entries.weight(b.cursor);  // by weight desc
+}
+
+// for a max-heap of chunks with the best head element on top
+bool is_head_element_worse(const Chunk& a, const Chunk& b) {
+  return compare_chunk_by_head_element(b, a);
 }
 
 struct CodeMatch {
@@ -98,15 +104,15 @@ CodeMatch match_extra_code(const table::Code* extra_code,
     else
       return kFailed;
   }
-  auto& index = syll_graph.indices[current_pos];
   SyllableId current_syll_id = extra_code->at[depth];
-  auto spellings = index.find(current_syll_id);
-  if (spellings == index.end())
+  const auto* syllable =
+      syll_graph.indices.Find(current_pos, current_syll_id);
+  if (!syllable)
     return kFailed;
   CodeMatch best_match = kFailed;
-  for (const SpellingProperties* props : spellings->second) {
+  for (const auto& props : syll_graph.indices.spellings(*syllable)) {
     CodeMatch match = match_extra_code(extra_code, depth + 1, syll_graph,
-                                       props->end_pos, predict_word);
+                                       props.end_pos, predict_word);
     if (!match.success)
       continue;
     if (match.end_pos > best_match.end_pos)
@@ -123,14 +129,15 @@ DictEntryIterator::DictEntryIterator()
 void DictEntryIterator::AddChunk(dictionary::Chunk&& chunk) {
   query_result_->chunks.push_back(std::move(chunk));
   entry_count_ += chunk.size;
+  is_heap_ = false;
 }
 
 void DictEntryIterator::Sort() {
   auto& chunks = query_result_->chunks;
-  // partial-sort remaining chunks, move best match to chunk_index_
-  std::partial_sort(chunks.begin() + chunk_index_,
-                    chunks.begin() + chunk_index_ + 1, chunks.end(),
-                    dictionary::compare_chunk_by_head_element);
+  // arrange remaining chunks in a heap, with the best match at chunk_index_
+  std::make_heap(chunks.begin() + chunk_index_, chunks.end(),
+                 dictionary::is_head_element_worse);
+  is_heap_ = true;
 }
 
 void DictEntryIterator::AddFilter(DictEntryFilter filter) {
@@ -142,18 +149,46 @@ void DictEntryIterator::AddFilter(DictEntryFilter filter) {
   }
 }
 
+static const double kS = 18.420680743952367;  // log(1e8)
+
+DictEntryView DictEntryIterator::PeekView() const {
+  DictEntryView view;
+  if (exhausted())
+    return view;
+  const auto& chunk = query_result_->chunks[chunk_index_];
+  view.table = chunk.table;
+  view.text_id = &chunk.entries.text(chunk.cursor);
+  view.code = &chunk.code;
+  view.weight = chunk.entries.weight(chunk.cursor) - kS + chunk.credibility;
+  view.remaining_code_length = chunk.remaining_code.length();
+  if (chunk.is_predictive_match()) {
+    view.matching_code_size = chunk.matching_code_size;
+  }
+  return view;
+}
+
 an<DictEntry> DictEntryIterator::Peek() {
   if (!entry_ && !exhausted()) {
     // get next entry from current chunk
     const auto& chunk = query_result_->chunks[chunk_index_];
-    const auto& e = chunk.entries[chunk.cursor];
-    DLOG(INFO) << "creating temporary dict entry '"
-               << chunk.table->GetEntryText(e) << "'.";
-    entry_ = New<DictEntry>();
+    if (spare_entry_ && spare_entry_.use_count() == 1) {
+      entry_ = std::move(spare_entry_);
+      entry_->comment.clear();
+      entry_->preedit.clear();
+      entry_->custom_code.clear();
+      entry_->elements.clear();
+      entry_->commit_count = 0;
+      entry_->remaining_code_length = 0;
+      entry_->matching_code_size = 0;
+    } else {
+      spare_entry_.reset();
+      entry_ = New<DictEntry>();
+    }
     entry_->code = chunk.code;
-    entry_->text = chunk.table->GetEntryText(e);
-    const double kS = 18.420680743952367;  // log(1e8)
-    entry_->weight = e.weight - kS + chunk.credibility;
+    chunk.table->GetEntryText(chunk.entries.text(chunk.cursor), &entry_->text);
+    DLOG(INFO) << "creating temporary dict entry '" << entry_->text << "'.";
+    entry_->weight =
+        chunk.entries.weight(chunk.cursor) - kS + chunk.credibility;
     if (!chunk.remaining_code.empty()) {
       entry_->comment = "~" + chunk.remaining_code;
       entry_->remaining_code_length = chunk.remaining_code.length();
@@ -165,24 +200,48 @@ an<DictEntry> DictEntryIterator::Peek() {
   return entry_;
 }
 
+void DictEntryIterator::ReleaseEntry() {
+  // entries taken by candidates are left to them
+  if (entry_ && entry_.use_count() == 1) {
+    spare_entry_ = std::move(entry_);
+  } else {
+    entry_.reset();
+  }
+}
+
 bool DictEntryIterator::FindNextEntry() {
+  ReleaseEntry();
   if (exhausted()) {
     return false;
   }
-  auto& chunk = query_result_->chunks[chunk_index_];
-  if (++chunk.cursor >= chunk.size) {
-    ++chunk_index_;
+  auto& chunks = query_result_->chunks;
+  auto& chunk = chunks[chunk_index_];
+  bool chunk_exhausted = ++chunk.cursor >= chunk.size;
+  if (!is_heap_) {
+    if (chunk_exhausted) {
+      ++chunk_index_;
+    }
+    if (exhausted()) {
+      return false;
+    }
+    // reorder chunks to move the one with the best entry to head
+    Sort();
+    return true;
   }
-  if (exhausted()) {
-    return false;
+  // the head chunk has moved on to its next entry; take it off the heap and
+  // put it back unless it has run out of entries.
+  auto heap_begin = chunks.begin() + chunk_index_;
+  std::pop_heap(heap_begin, chunks.end(), dictionary::is_head_element_worse);
+  if (chunk_exhausted) {
+    chunks.pop_back();
+  } else {
+    std::push_heap(heap_begin, chunks.end(),
+                   dictionary::is_head_element_worse);
   }
-  // reorder chunks to move the one with the best entry to head
-  Sort();
-  return true;
+  return !exhausted();
 }
 
 bool DictEntryIterator::Next() {
-  entry_.reset();
   if (!FindNextEntry()) {
     return false;
   }
@@ -196,6 +255,11 @@ bool DictEntryIterator::Next() {
 
 // Note: does not apply filters
 bool DictEntryIterator::Skip(size_t num_entries) {
+  if (num_entries > 0) {
+    ReleaseEntry();
+    // chunks are skipped in storage order, which breaks the heap
+    is_heap_ = false;
+  }
   while (num_entries > 0) {
     if (exhausted())
       return false;
@@ -249,11 +313,10 @@ static void lookup_table(Table* table,
       double cr = initial_credibility + a.credibility();
       if (end_pos < 0) {
         do {
-          auto entry = a.entry();
-          if (!predict.entries ||
-              cr + entry->weight > predict.credibility +
-                                       predict.entries[predict.cursor].weight) {
-            predict = {table, a.code(), entry, (size_t)-end_pos, cr};
+          if (predict.entries.empty() ||
+              cr + a.weight() > predict.credibility +
+                                    predict.entries.weight(predict.cursor)) {
+            predict = {table, a.code(), a.entries(), (size_t)-end_pos, cr};
           }
         } while (a.Next());
       } else if (a.extra_code()) {
@@ -264,15 +327,15 @@ static void lookup_table(Table* table,
             continue;
           size_t matching_code_size = a.index_code().size() + match.depth;
           (*collector)[match.end_pos].AddChunk(
-              {table, a.code(), a.entry(), matching_code_size, cr});
+              {table, a.code(), a.entries(), matching_code_size, cr});
         } while (a.Next());
       } else {
         (*collector)[end_pos].AddChunk({table, a, cr});
       }
     }
   }
-  if (predict.entries && predict.entries[predict.cursor].weight >=
-                             kPredictionThreshold - DBL_EPSILON) {
+  if (!predict.entries.empty() && predict.entries.weight(predict.cursor) >=
+                                      kPredictionThreshold - DBL_EPSILON) {
     (*collector)[-1].AddChunk(std::move(predict));
   }
 }
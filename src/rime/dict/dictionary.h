@@ -23,6 +23,20 @@ struct QueryResult;
 
 }  // namespace dictionary
 
+// the entry at the head of a DictEntryIterator, read in place from the
+// mapped table. valid until the iterator moves on.
+struct DictEntryView {
+  Table* table = nullptr;
+  const table::StringType* text_id = nullptr;
+  const Code* code = nullptr;
+  double weight = 0.0;
+  int remaining_code_length = 0;
+  int matching_code_size = 0;
+
+  explicit operator bool() const { return text_id != nullptr; }
+  string text() const { return table->GetEntryText(*text_id); }
+};
+
 class RIME_API DictEntryIterator : public DictEntryFilterBinder {
  public:
   DictEntryIterator();
@@ -36,6 +50,8 @@ class RIME_API DictEntryIterator : public DictEntryFilterBinder {
   void Sort();
   void AddFilter(DictEntryFilter filter) override;
   an<DictEntry> Peek();
+  // inspects the next entry without creating a DictEntry.
+  DictEntryView PeekView() const;
   bool Next();
   bool Skip(size_t num_entries);
   bool exhausted() const;
@@ -43,11 +59,16 @@ class RIME_API DictEntryIterator : public DictEntryFilterBinder {
 
  protected:
   bool FindNextEntry();
+  void ReleaseEntry();
 
  private:
   an<dictionary::QueryResult> query_result_;
   size_t chunk_index_ = 0;
+  // whether the remaining chunks form a heap with the best one on top
+  bool is_heap_ = false;
   an<DictEntry> entry_ = nullptr;
+  // a released entry no one else refers to, recycled by the next Peek()
+  an<DictEntry> spare_entry_ = nullptr;
   size_t entry_count_ = 0;
 };
 
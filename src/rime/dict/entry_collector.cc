@@ -5,16 +5,133 @@
 // 2011-11-27 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <cctype>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <string_view>
 #include <utility>
 #include <boost/algorithm/string.hpp>
-#include <rime/algo/strings.h>
+#include <rime/worker_pool.h>
 #include <rime/dict/dict_settings.h>
 #include <rime/dict/entry_collector.h>
+#include <rime/dict/mapped_file.h>
 #include <rime/dict/preset_vocabulary.h>
 
 namespace rime {
 
+// a dict source file mapped into memory. rows are parsed in place, and
+// refer to the file contents as long as the source is open.
+class DictSource : public MappedFile {
+ public:
+  struct Row {
+    std::string_view text;
+    std::string_view code;
+    std::string_view weight;
+    std::string_view stem;
+  };
+
+  explicit DictSource(const path& file_path) : MappedFile(file_path) {}
+
+  // can run in any thread
+  bool Parse();
+
+  bool parsed() const { return parsed_; }
+  const vector<Row>& rows() const { return rows_; }
+
+ private:
+  std::string_view Contents();
+
+  bool parsed_ = false;
+  vector<Row> rows_;
+};
+
+// returns the line starting at *pos with trailing spaces removed, and
+// advances *pos to the next line.
+static std::string_view NextLine(std::string_view text, size_t* pos) {
+  size_t end = text.find('\n', *pos);
+  if (end == std::string_view::npos)
+    end = text.length();
+  std::string_view line = text.substr(*pos, end - *pos);
+  *pos = end + 1;
+  while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+    line.remove_suffix(1);
+  return line;
+}
+
+std::string_view DictSource::Contents() {
+  std::error_code ec;
+  if (std::filesystem::file_size(file_path(), ec) == 0 || ec)
+    return {};
+  try {
+    if (!OpenReadOnly())
+      return {};
+  } catch (...) {
+    LOG(ERROR) << "error opening file '" << file_path() << "'.";
+    return {};
+  }
+  return {address(), file_size()};
+}
+
+bool DictSource::Parse() {
+  std::string_view contents = Contents();
+  size_t pos = 0;
+  while (pos < contents.length()) {
+    if (NextLine(contents, &pos) == "...")  // yaml doc ending
+      break;
+  }
+  std::istringstream header(string(contents.substr(0, pos)));
+  DictSettings settings;
+  if (!settings.LoadDictHeader(header)) {
+    LOG(ERROR) << "missing dict settings in '" << file_path() << "'.";
+    return false;
+  }
+  // column definitions
+  int text_column = settings.GetColumnIndex("text");
+  int code_column = settings.GetColumnIndex("code");
+  int weight_column = settings.GetColumnIndex("weight");
+  int stem_column = settings.GetColumnIndex("stem");
+  if (text_column == -1) {
+    LOG(ERROR) << "missing text column definition in '" << file_path() << "'.";
+    return false;
+  }
+  bool enable_comment = true;
+  while (pos < contents.length()) {
+    std::string_view line = NextLine(contents, &pos);
+    // skip empty lines and comments
+    if (line.empty())
+      continue;
+    if (enable_comment && line[0] == '#') {
+      if (line == "# no comment") {
+        // a "# no comment" line disables further comments
+        enable_comment = false;
+      }
+      continue;
+    }
+    // a row with empty text is kept to be reported when collected
+    Row row;
+    size_t start = 0;
+    for (int column = 0; start != std::string_view::npos; ++column) {
+      size_t end = line.find('\t', start);
+      std::string_view field = line.substr(
+          start, end == std::string_view::npos ? end : end - start);
+      if (column == text_column)
+        row.text = field;
+      if (column == code_column)
+        row.code = field;
+      if (column == weight_column)
+        row.weight = field;
+      if (column == stem_column)
+        row.stem = field;
+      start = end == std::string_view::npos ? end : end + 1;
+    }
+    rows_.push_back(row);
+  }
+  parsed_ = true;
+  return true;
+}
+
 EntryCollector::EntryCollector() {}
 
 EntryCollector::EntryCollector(Syllabary&& fixed_syllabary)
@@ -35,9 +152,30 @@ void EntryCollector::Configure(DictSettings* settings) {
   encoder->LoadSettings(settings);
 }
 
-void EntryCollector::Collect(const vector<path>& dict_files) {
-  for (const path& dict_file : dict_files) {
-    Collect(dict_file);
+void EntryCollector::Collect(const vector<path>& dict_files,
+                             WorkerPool* pool) {
+  // tables are parsed in parallel, while their entries are collected in the
+  // given order. only a few tables are parsed ahead of the one collected, so
+  // that not all of them are held in memory at once.
+  WorkerPool in_this_thread(0);
+  if (!pool)
+    pool = &in_this_thread;
+  const size_t max_parsing = pool->num_workers() + 1;
+  std::deque<std::future<the<DictSource>>> sources;
+  auto next_file = dict_files.begin();
+  while (next_file != dict_files.end() || !sources.empty()) {
+    while (next_file != dict_files.end() && sources.size() < max_parsing) {
+      const path& dict_file = *next_file++;
+      sources.push_back(pool->Post([dict_file] {
+        the<DictSource> source(new DictSource(dict_file));
+        source->Parse();
+        return source;
+      }));
+    }
+    the<DictSource> source = sources.front().get();
+    sources.pop_front();
+    Collect(*source);
+    // released before more tables are posted to parse
   }
   Finish();
 }
@@ -54,58 +192,21 @@ void EntryCollector::LoadPresetVocabulary(DictSettings* settings) {
   }
 }
 
-void EntryCollector::Collect(const path& dict_file) {
-  LOG(INFO) << "collecting entries from " << dict_file;
-  // read table
-  std::ifstream fin(dict_file.c_str());
-  DictSettings settings;
-  if (!settings.LoadDictHeader(fin)) {
-    LOG(ERROR) << "missing dict settings.";
+void EntryCollector::Collect(const DictSource& source) {
+  LOG(INFO) << "collecting entries from " << source.file_path();
+  if (!source.parsed())
     return;
-  }
-  // column definitions
-  int text_column = settings.GetColumnIndex("text");
-  int code_column = settings.GetColumnIndex("code");
-  int weight_column = settings.GetColumnIndex("weight");
-  int stem_column = settings.GetColumnIndex("stem");
-  if (text_column == -1) {
-    LOG(ERROR) << "missing text column definition.";
-    return;
-  }
-  bool enable_comment = true;
-  string line;
-  while (getline(fin, line)) {
-    boost::algorithm::trim_right(line);
-    // skip empty lines and comments
-    if (line.empty())
-      continue;
-    if (enable_comment && line[0] == '#') {
-      if (line == "# no comment") {
-        // a "# no comment" line disables further comments
-        enable_comment = false;
-      }
-      continue;
-    }
-    // read a dict entry
-    auto row = strings::split(line, "\t");
-    int num_columns = static_cast<int>(row.size());
-    if (num_columns <= text_column || row[text_column].empty()) {
+  string word;
+  string code_str;
+  string weight_str;
+  for (const auto& row : source.rows()) {
+    if (row.text.empty()) {
       LOG(WARNING) << "Missing entry text at #" << num_entries << ".";
       continue;
     }
-    const auto& word(row[text_column]);
-    string code_str;
-    string weight_str;
-    string stem_str;
-    if (code_column != -1 && num_columns > code_column &&
-        !row[code_column].empty())
-      code_str = row[code_column];
-    if (weight_column != -1 && num_columns > weight_column &&
-        !row[weight_column].empty())
-      weight_str = row[weight_column];
-    if (stem_column != -1 && num_columns > stem_column &&
-        !row[stem_column].empty())
-      stem_str = row[stem_column];
+    word.assign(row.text);
+    code_str.assign(row.code);
+    weight_str.assign(row.weight);
     // collect entry
     collection.insert(word);
     if (!code_str.empty()) {
@@ -113,13 +214,12 @@ void EntryCollector::Collect(const path& dict_file) {
     } else {
       encode_queue.push({word, weight_str});
     }
-    if (!stem_str.empty() && !code_str.empty()) {
+    if (!row.stem.empty() && !code_str.empty()) {
       DLOG(INFO) << "add stem '" << word << "': "
-                 << "[" << code_str << "] = [" << stem_str << "]";
-      stems[word].insert(stem_str);
+                 << "[" << code_str << "] = [" << row.stem << "]";
+      stems[word].insert(string(row.stem));
     }
   }
-  fin.close();
   LOG(INFO) << "Pass 1: total " << num_entries << " entries collected.";
   LOG(INFO) << "num unique syllables: " << syllabary.size();
   LOG(INFO) << "num of entries to encode: " << encode_queue.size();
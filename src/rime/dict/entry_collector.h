@@ -32,6 +32,8 @@ using EncodeQueue = std::queue<pair<string, string>>;
 
 class PresetVocabulary;
 class DictSettings;
+class DictSource;
+class WorkerPool;
 
 class EntryCollector : public PhraseCollector {
  public:
@@ -47,7 +49,8 @@ class EntryCollector : public PhraseCollector {
   virtual ~EntryCollector();
 
   void Configure(DictSettings* settings);
-  void Collect(const vector<path>& dict_files);
+  // dict files are parsed ahead on the pool if given, or one by one.
+  void Collect(const vector<path>& dict_files, WorkerPool* pool = nullptr);
 
   // export contents of table and prism to text files
   void Dump(const path& file_path) const;
@@ -59,8 +62,8 @@ class EntryCollector : public PhraseCollector {
 
  protected:
   void LoadPresetVocabulary(DictSettings* settings);
-  // call Collect() multiple times for all required tables
-  void Collect(const path& dict_file);
+  // call Collect() for all required tables, in order
+  void Collect(const DictSource& source);
   // encode all collected entries
   void Finish();
 
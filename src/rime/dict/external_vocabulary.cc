@@ -0,0 +1,318 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <filesystem>
+#include <queue>
+#include <rime/dict/external_vocabulary.h>
+
+namespace rime {
+
+static bool write_entry(std::ostream& out, const ShortDictEntry& entry) {
+  uint32_t code_length = static_cast<uint32_t>(entry.code.size());
+  uint32_t text_length = static_cast<uint32_t>(entry.text.length());
+  out.write(reinterpret_cast<const char*>(&code_length), sizeof(code_length));
+  out.write(reinterpret_cast<const char*>(entry.code.data()),
+            code_length * sizeof(SyllableId));
+  out.write(reinterpret_cast<const char*>(&entry.weight), sizeof(entry.weight));
+  out.write(reinterpret_cast<const char*>(&text_length), sizeof(text_length));
+  out.write(entry.text.data(), text_length);
+  return bool(out);
+}
+
+static bool read_entry(std::istream& in, ShortDictEntry* entry) {
+  uint32_t code_length = 0;
+  if (!in.read(reinterpret_cast<char*>(&code_length), sizeof(code_length)))
+    return false;
+  entry->code.resize(code_length);
+  in.read(reinterpret_cast<char*>(entry->code.data()),
+          code_length * sizeof(SyllableId));
+  in.read(reinterpret_cast<char*>(&entry->weight), sizeof(entry->weight));
+  uint32_t text_length = 0;
+  in.read(reinterpret_cast<char*>(&text_length), sizeof(text_length));
+  entry->text.resize(text_length);
+  in.read(&entry->text[0], text_length);
+  return bool(in);
+}
+
+static size_t index_code_length(const Code& code) {
+  return code.size() < Code::kIndexCodeMaxLength ? code.size()
+                                                 : Code::kIndexCodeMaxLength;
+}
+
+// the order of entries in a table: by index code, where the entries of a code
+// come before those of longer codes it prefixes, and codes longer than the
+// index code come last. homophones are ordered by weight desc if sorted.
+struct TableOrder {
+  bool sort_homophones;
+
+  bool operator()(const ShortDictEntry& a, const ShortDictEntry& b) const {
+    size_t a_length = index_code_length(a.code);
+    size_t b_length = index_code_length(b.code);
+    for (size_t i = 0; i < a_length && i < b_length; ++i) {
+      if (a.code[i] != b.code[i])
+        return a.code[i] < b.code[i];
+    }
+    if (a_length != b_length)
+      return a_length < b_length;
+    bool a_is_long = a.code.size() > Code::kIndexCodeMaxLength;
+    bool b_is_long = b.code.size() > Code::kIndexCodeMaxLength;
+    if (a_is_long != b_is_long)
+      return b_is_long;
+    return sort_homophones && a.weight > b.weight;
+  }
+};
+
+// counts the entries and child nodes of each index node as the merged entries
+// pass by. a count is known when its node is closed, and is written to the
+// slot where the table builder reads it when opening the node.
+class IndexCounter {
+ public:
+  explicit IndexCounter(const path& file_path)
+      : out_(file_path.c_str(), std::ios::binary | std::ios::trunc) {}
+
+  void Add(const ShortDictEntry& entry) {
+    size_t depth = index_code_length(entry.code);
+    size_t common = 0;
+    while (common < nodes_.size() && common < depth &&
+           nodes_[common].key == entry.code[common])
+      ++common;
+    Close(common);
+    while (nodes_.size() < depth) {
+      Open(entry.code[nodes_.size()]);
+    }
+    if (entry.code.size() > Code::kIndexCodeMaxLength) {
+      // tail entries are the children of the last level
+      AddChild(&nodes_.back());
+    } else {
+      ++nodes_.back().num_entries;
+    }
+  }
+
+  bool Finish() {
+    Close(0);
+    out_.close();
+    return bool(out_);
+  }
+
+ private:
+  static constexpr size_t kNoSlot = size_t(-1);
+
+  struct Node {
+    SyllableId key;
+    size_t entries_slot;
+    uint32_t num_entries = 0;
+    size_t children_slot = kNoSlot;
+    uint32_t num_children = 0;
+  };
+
+  void Open(SyllableId key) {
+    if (!nodes_.empty())
+      AddChild(&nodes_.back());
+    nodes_.push_back({key, next_slot_++});
+  }
+
+  void AddChild(Node* node) {
+    if (node->children_slot == kNoSlot)
+      node->children_slot = next_slot_++;
+    ++node->num_children;
+  }
+
+  void Close(size_t depth) {
+    while (nodes_.size() > depth) {
+      const Node& node(nodes_.back());
+      Write(node.entries_slot, node.num_entries);
+      if (node.children_slot != kNoSlot)
+        Write(node.children_slot, node.num_children);
+      nodes_.pop_back();
+    }
+  }
+
+  void Write(size_t slot, uint32_t count) {
+    out_.seekp(slot * sizeof(count));
+    out_.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  }
+
+  std::ofstream out_;
+  vector<Node> nodes_;
+  size_t next_slot_ = 0;
+};
+
+ExternalVocabulary::ExternalVocabulary(const path& file_prefix,
+                                       size_t memory_limit,
+                                       bool sort_homophones)
+    : file_prefix_(file_prefix),
+      memory_limit_(memory_limit),
+      sort_homophones_(sort_homophones) {}
+
+ExternalVocabulary::~ExternalVocabulary() {
+  for (const auto& file : temp_files_) {
+    std::error_code ec;
+    std::filesystem::remove(file, ec);
+  }
+}
+
+path ExternalVocabulary::NewTempFile() {
+  path file_path(file_prefix_);
+  file_path += "." + std::to_string(temp_files_.size()) + ".tmp";
+  temp_files_.push_back(file_path);
+  return file_path;
+}
+
+bool ExternalVocabulary::Add(ShortDictEntry&& entry) {
+  if (entry.code.empty()) {
+    LOG(ERROR) << "missing code for entry '" << entry.text << "'.";
+    return false;
+  }
+  if (buffer_.size() == buffer_.capacity() && !Grow())
+    return false;
+  entries_size_ +=
+      entry.code.capacity() * sizeof(SyllableId) + entry.text.capacity();
+  buffer_.push_back(std::move(entry));
+  ++num_entries_;
+  if (buffer_size() > memory_limit_)
+    return Spill();
+  return true;
+}
+
+// the buffer is grown by reserving no more slots than the memory limit
+// allows; it is spilled instead when there is no room left to grow.
+bool ExternalVocabulary::Grow() {
+  const size_t kMinSlots = 16;
+  size_t room =
+      memory_limit_ > entries_size_ ? memory_limit_ - entries_size_ : 0;
+  size_t max_slots = room / sizeof(ShortDictEntry);
+  if (max_slots <= buffer_.size())
+    return Spill();
+  buffer_.reserve(
+      (std::min)(max_slots, (std::max)(kMinSlots, buffer_.size() * 2)));
+  return true;
+}
+
+bool ExternalVocabulary::Spill() {
+  if (buffer_.empty())
+    return true;
+  std::stable_sort(buffer_.begin(), buffer_.end(),
+                   TableOrder{sort_homophones_});
+  path run = NewTempFile();
+  std::ofstream out(run.c_str(), std::ios::binary | std::ios::trunc);
+  for (const auto& entry : buffer_) {
+    if (!write_entry(out, entry))
+      break;
+  }
+  out.close();
+  if (!out) {
+    LOG(ERROR) << "error writing sorted run '" << run << "'.";
+    return false;
+  }
+  runs_.push_back(run);
+  ++num_runs_;
+  // slots are kept for the next run
+  buffer_.clear();
+  entries_size_ = 0;
+  return true;
+}
+
+bool ExternalVocabulary::Merge(const vector<path>& runs,
+                               const path& output,
+                               const path& counts_file) {
+  struct Cursor {
+    std::ifstream in;
+    ShortDictEntry entry;
+    size_t run;
+  };
+  TableOrder order{sort_homophones_};
+  // of equal entries, those from earlier runs were added earlier
+  auto later = [&order](const Cursor* a, const Cursor* b) {
+    if (order(b->entry, a->entry))
+      return true;
+    if (order(a->entry, b->entry))
+      return false;
+    return a->run > b->run;
+  };
+  vector<the<Cursor>> cursors;
+  std::priority_queue<Cursor*, vector<Cursor*>, decltype(later)> queue(later);
+  for (size_t i = 0; i < runs.size(); ++i) {
+    cursors.emplace_back(new Cursor{
+        std::ifstream(runs[i].c_str(), std::ios::binary), {}, i});
+    if (read_entry(cursors.back()->in, &cursors.back()->entry))
+      queue.push(cursors.back().get());
+  }
+  the<IndexCounter> counter;
+  if (!counts_file.empty())
+    counter.reset(new IndexCounter(counts_file));
+  std::ofstream out(output.c_str(), std::ios::binary | std::ios::trunc);
+  while (!queue.empty()) {
+    Cursor* cursor = queue.top();
+    queue.pop();
+    if (!write_entry(out, cursor->entry))
+      break;
+    if (counter)
+      counter->Add(cursor->entry);
+    if (read_entry(cursor->in, &cursor->entry))
+      queue.push(cursor);
+  }
+  out.close();
+  if (!out || (counter && !counter->Finish())) {
+    LOG(ERROR) << "error merging sorted runs into '" << output << "'.";
+    return false;
+  }
+  return true;
+}
+
+bool ExternalVocabulary::Finish() {
+  if (!Spill())
+    return false;
+  vector<ShortDictEntry>().swap(buffer_);
+  LOG(INFO) << "merging " << runs_.size() << " sorted runs of "
+            << num_entries_ << " entries.";
+  // limit the number of files open at the same time
+  const size_t kMaxMergeWidth = 64;
+  while (runs_.size() > kMaxMergeWidth) {
+    vector<path> batch(runs_.begin(), runs_.begin() + kMaxMergeWidth);
+    path merged = NewTempFile();
+    if (!Merge(batch, merged, path()))
+      return false;
+    for (const auto& run : batch) {
+      std::error_code ec;
+      std::filesystem::remove(run, ec);
+    }
+    runs_.erase(runs_.begin() + 1, runs_.begin() + kMaxMergeWidth);
+    runs_.front() = merged;
+  }
+  merged_file_ = NewTempFile();
+  counts_file_ = NewTempFile();
+  if (!Merge(runs_, merged_file_, counts_file_))
+    return false;
+  for (const auto& run : runs_) {
+    std::error_code ec;
+    std::filesystem::remove(run, ec);
+  }
+  runs_.clear();
+  return true;
+}
+
+ExternalVocabularyReader::ExternalVocabularyReader(
+    const ExternalVocabulary& vocabulary)
+    : entries_(vocabulary.merged_file().c_str(), std::ios::binary),
+      counts_(vocabulary.counts_file().c_str(), std::ios::binary) {
+  Next();
+}
+
+void ExternalVocabularyReader::Next() {
+  exhausted_ = !read_entry(entries_, &entry_);
+}
+
+bool ExternalVocabularyReader::HasPrefix(const Code& prefix) const {
+  return !exhausted_ && entry_.code.size() > prefix.size() &&
+         std::equal(prefix.begin(), prefix.end(), entry_.code.begin());
+}
+
+size_t ExternalVocabularyReader::NextCount() {
+  uint32_t count = 0;
+  counts_.read(reinterpret_cast<char*>(&count), sizeof(count));
+  return count;
+}
+
+}  // namespace rime
@@ -0,0 +1,86 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_EXTERNAL_VOCABULARY_H_
+#define RIME_EXTERNAL_VOCABULARY_H_
+
+#include <fstream>
+#include <rime_api.h>
+#include <rime/common.h>
+#include <rime/dict/vocabulary.h>
+
+namespace rime {
+
+// a vocabulary built within limited memory, for very large dictionaries.
+// entries are sorted in runs spilled to temporary files, which are then
+// merged in the order they are laid out in a table.
+class ExternalVocabulary {
+ public:
+  // temporary files are named after file_prefix. no more than memory_limit
+  // bytes of entries are kept in memory.
+  RIME_API ExternalVocabulary(const path& file_prefix,
+                              size_t memory_limit,
+                              bool sort_homophones = true);
+  RIME_API ~ExternalVocabulary();
+
+  RIME_API bool Add(ShortDictEntry&& entry);
+  // merges all entries; no more entries can be added afterwards.
+  RIME_API bool Finish();
+
+  size_t num_entries() const { return num_entries_; }
+  size_t num_runs() const { return num_runs_; }
+  const path& merged_file() const { return merged_file_; }
+  const path& counts_file() const { return counts_file_; }
+
+ private:
+  path NewTempFile();
+  // bytes held by the buffer, including its unused slots.
+  size_t buffer_size() const {
+    return buffer_.capacity() * sizeof(ShortDictEntry) + entries_size_;
+  }
+  bool Grow();
+  bool Spill();
+  bool Merge(const vector<path>& runs,
+             const path& output,
+             const path& counts_file);
+
+  path file_prefix_;
+  size_t memory_limit_;
+  bool sort_homophones_;
+  vector<ShortDictEntry> buffer_;
+  // bytes the buffered entries allocate outside of the buffer
+  size_t entries_size_ = 0;
+  size_t num_entries_ = 0;
+  size_t num_runs_ = 0;
+  vector<path> runs_;
+  vector<path> temp_files_;
+  path merged_file_;
+  path counts_file_;
+};
+
+// reads the merged entries in order, along with the size of each index
+// node and entry list a table builder asks for before filling it.
+class ExternalVocabularyReader {
+ public:
+  explicit ExternalVocabularyReader(const ExternalVocabulary& vocabulary);
+
+  bool exhausted() const { return exhausted_; }
+  // the current entry; valid unless exhausted.
+  const ShortDictEntry& entry() const { return entry_; }
+  void Next();
+  // whether the current entry has a code longer than the prefix.
+  bool HasPrefix(const Code& prefix) const;
+  // size of the next index node or entry list in table order.
+  size_t NextCount();
+
+ private:
+  std::ifstream entries_;
+  std::ifstream counts_;
+  ShortDictEntry entry_;
+  bool exhausted_ = false;
+};
+
+}  // namespace rime
+
+#endif  // RIME_EXTERNAL_VOCABULARY_H_
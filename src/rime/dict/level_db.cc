@@ -5,9 +5,12 @@
 // 2014-12-04 Chen Gong <chen.sst@gmail.com>
 //
 
+#include <leveldb/cache.h>
 #include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
 #include <leveldb/write_batch.h>
 #include <rime/common.h>
+#include <rime/config.h>
 #include <rime/service.h>
 #include <rime/dict/level_db.h>
 #include <rime/dict/user_db.h>
@@ -19,9 +22,9 @@ static const char* kMetaCharacter = "\x01";
 struct LevelDbCursor {
   leveldb::Iterator* iterator = nullptr;
 
-  LevelDbCursor(leveldb::DB* db) {
+  LevelDbCursor(leveldb::DB* db, bool fill_cache) {
     leveldb::ReadOptions options;
-    options.fill_cache = false;
+    options.fill_cache = fill_cache;
     iterator = db->NewIterator(options);
   }
 
@@ -50,19 +53,43 @@ struct LevelDbCursor {
 struct LevelDbWrapper {
   leveldb::DB* ptr = nullptr;
   leveldb::WriteBatch batch;
-
-  leveldb::Status Open(const path& file_path, bool readonly) {
+  // owned by the wrapper, and must outlive the db
+  the<leveldb::Cache> block_cache;
+  the<const leveldb::FilterPolicy> filter_policy;
+  bool fill_cache_on_query = false;
+
+  leveldb::Status Open(const path& file_path,
+                       bool readonly,
+                       const LevelDbOptions& db_options) {
     leveldb::Options options;
     options.create_if_missing = !readonly;
+    if (db_options.bloom_filter_bits > 0) {
+      filter_policy.reset(
+          leveldb::NewBloomFilterPolicy(db_options.bloom_filter_bits));
+      options.filter_policy = filter_policy.get();
+    }
+    if (db_options.block_cache_size > 0) {
+      block_cache.reset(leveldb::NewLRUCache(db_options.block_cache_size));
+      options.block_cache = block_cache.get();
+    }
+    if (db_options.write_buffer_size > 0)
+      options.write_buffer_size = db_options.write_buffer_size;
+    if (db_options.block_size > 0)
+      options.block_size = db_options.block_size;
+    fill_cache_on_query = db_options.fill_cache_on_query;
     return leveldb::DB::Open(options, file_path.string(), &ptr);
   }
 
   void Release() {
     delete ptr;
     ptr = nullptr;
+    block_cache.reset();
+    filter_policy.reset();
   }
 
-  LevelDbCursor* CreateCursor() { return new LevelDbCursor(ptr); }
+  LevelDbCursor* CreateCursor() {
+    return new LevelDbCursor(ptr, fill_cache_on_query);
+  }
 
   bool Fetch(const string& key, string* value) {
     auto status = ptr->Get(leveldb::ReadOptions(), key, value);
@@ -137,6 +164,23 @@ bool LevelDbAccessor::exhausted() {
   return !cursor_->IsValid() || !MatchesPrefix(cursor_->GetKey());
 }
 
+// LevelDbOptions members
+
+void LevelDbOptions::Load(Config* config, const string& key) {
+  if (!config)
+    return;
+  int value = 0;
+  if (config->GetInt(key + "/bloom_filter_bits", &value))
+    bloom_filter_bits = (std::max)(0, value);
+  if (config->GetInt(key + "/block_cache_size", &value))
+    block_cache_size = (std::max)(0, value);
+  if (config->GetInt(key + "/write_buffer_size", &value))
+    write_buffer_size = (std::max)(0, value);
+  if (config->GetInt(key + "/block_size", &value))
+    block_size = (std::max)(0, value);
+  config->GetBool(key + "/fill_cache_on_query", &fill_cache_on_query);
+}
+
 // LevelDb members
 
 LevelDb::LevelDb(const path& file_path,
@@ -151,6 +195,14 @@ LevelDb::~LevelDb() {
 
 void LevelDb::Initialize() {
   db_.reset(new LevelDbWrapper);
+  if (has_options_)
+    return;
+  if (auto component = Config::Require("config")) {
+    the<Config> config(component->Create("default"));
+    options_.Load(config.get(), "leveldb");
+    options_.Load(config.get(), "leveldb/" + name());
+  }
+  has_options_ = true;
 }
 
 an<DbAccessor> LevelDb::QueryMetadata() {
@@ -244,7 +296,7 @@ bool LevelDb::Open() {
     return false;
   Initialize();
   readonly_ = false;
-  auto status = db_->Open(file_path(), readonly_);
+  auto status = db_->Open(file_path(), readonly_, options_);
   loaded_ = status.ok();
 
   if (loaded_) {
@@ -266,7 +318,7 @@ bool LevelDb::OpenReadOnly() {
     return false;
   Initialize();
   readonly_ = true;
-  auto status = db_->Open(file_path(), readonly_);
+  auto status = db_->Open(file_path(), readonly_, options_);
   loaded_ = status.ok();
 
   if (!loaded_) {
@@ -14,8 +14,26 @@ namespace rime {
 struct LevelDbCursor;
 struct LevelDbWrapper;
 
+class Config;
 class LevelDb;
 
+// tuning of leveldb, favouring point lookups of UpdateEntry.
+struct LevelDbOptions {
+  // bits per key in bloom filters, which save disk reads when fetching
+  // missing keys; 0 to disable.
+  int bloom_filter_bits = 10;
+  // capacity of the cache of uncompressed blocks in bytes.
+  size_t block_cache_size = 8 << 20;
+  size_t write_buffer_size = 4 << 20;
+  size_t block_size = 4 << 10;
+  // whether blocks read by range queries are kept in the cache, at the cost
+  // of evicting blocks of point lookups.
+  bool fill_cache_on_query = false;
+
+  // reads the options under key in config, keeping those unspecified.
+  RIME_API void Load(Config* config, const string& key);
+};
+
 class LevelDbAccessor : public DbAccessor {
  public:
   LevelDbAccessor();
@@ -39,6 +57,14 @@ class LevelDb : public Db, public Recoverable, public Transactional {
           const string& db_type = "");
   virtual ~LevelDb();
 
+  // takes effect on the next Open(); unless set, options are read from
+  // `leveldb` and then `leveldb/<db name>` in default.yaml.
+  void set_options(const LevelDbOptions& options) {
+    options_ = options;
+    has_options_ = true;
+  }
+  const LevelDbOptions& options() const { return options_; }
+
   bool Remove() override;
   bool Open() override;
   bool OpenReadOnly() override;
@@ -57,6 +83,7 @@ class LevelDb : public Db, public Recoverable, public Transactional {
   bool Fetch(const string& key, string* value) override;
   bool Update(const string& key, const string& value) override;
   bool Erase(const string& key) override;
+  bool binary_safe() const override { return true; }
 
   // Recoverable
   bool Recover() override;
@@ -71,6 +98,8 @@ class LevelDb : public Db, public Recoverable, public Transactional {
 
   the<LevelDbWrapper> db_;
   string db_type_;
+  LevelDbOptions options_;
+  bool has_options_ = false;
 };
 
 }  // namespace rime
@@ -254,11 +254,46 @@ void Prism::CommonPrefixSearch(const string& key, vector<Match>* result) {
     return;
   size_t len = key.length();
   result->resize(len);
-  size_t num_results =
-      trie_->commonPrefixSearch(key.c_str(), &result->front(), len, len);
+  size_t num_results = CommonPrefixSearch(key, &result->front(), len);
   result->resize(num_results);
 }
 
+size_t Prism::CommonPrefixSearch(std::string_view key,
+                                 Match* results,
+                                 size_t max_results) const {
+  // a zero length would have darts look for the terminating null
+  if (key.empty() || !trie_ || !trie_->array())
+    return 0;
+  return trie_->commonPrefixSearch(key.data(), results, max_results,
+                                   key.length());
+}
+
+size_t Prism::Traverse(std::string_view key,
+                       Cursor* cursor,
+                       Match* results,
+                       size_t max_results) const {
+  if (!trie_ || !trie_->array()) {
+    // not loaded
+    cursor->stopped = true;
+    return 0;
+  }
+  size_t num_results = 0;
+  while (!cursor->stopped && cursor->key_pos < key.length() &&
+         num_results < max_results) {
+    int value = trie_->traverse(key.data(), cursor->node_pos, cursor->key_pos,
+                                cursor->key_pos + 1);
+    if (value == -2) {
+      cursor->stopped = true;
+    } else if (value >= 0) {
+      results[num_results].value = value;
+      results[num_results].length = cursor->key_pos;
+      results[num_results].distance = 0;
+      ++num_results;
+    }
+  }
+  return num_results;
+}
+
 void Prism::ExpandSearch(const string& key,
                          vector<Match>* result,
                          size_t limit) {
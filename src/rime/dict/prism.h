@@ -9,6 +9,7 @@
 #ifndef RIME_PRISM_H_
 #define RIME_PRISM_H_
 
+#include <string_view>
 #include <darts.h>
 #include <rime/common.h>
 #include <rime/algo/spelling.h>
@@ -68,6 +69,15 @@ class Prism : public MappedFile {
   struct Match : Darts::DoubleArray::result_pair_type {
     size_t distance = 0;
   };
+  // where a walk along a key has got to in the trie, so that it can be
+  // resumed as the key grows.
+  struct Cursor {
+    size_t node_pos = 0;
+    // number of characters of the key consumed
+    size_t key_pos = 0;
+    // the next character of the key leads nowhere
+    bool stopped = false;
+  };
 
   RIME_API explicit Prism(const path& file_path);
 
@@ -81,6 +91,18 @@ class Prism : public MappedFile {
   RIME_API bool HasKey(const string& key);
   RIME_API bool GetValue(const string& key, int* value) const;
   RIME_API void CommonPrefixSearch(const string& key, vector<Match>* result);
+  // stores at most max_results matches in the caller's buffer, and returns
+  // the number of all the matches.
+  RIME_API size_t CommonPrefixSearch(std::string_view key,
+                                     Match* results,
+                                     size_t max_results) const;
+  // walks on along key from cursor, storing the matches found on the way.
+  // stops early when the buffer is full; call again with the same cursor to
+  // continue. returns the number of matches stored.
+  RIME_API size_t Traverse(std::string_view key,
+                           Cursor* cursor,
+                           Match* results,
+                           size_t max_results) const;
   RIME_API void ExpandSearch(const string& key,
                              vector<Match>* result,
                              size_t limit);
@@ -86,7 +86,6 @@ bool ReverseDb::Build(DictSettings* settings,
                       const Vocabulary& vocabulary,
                       const ReverseLookupTable& stems,
                       uint32_t dict_file_checksum) {
-  LOG(INFO) << "building reversedb...";
   ReverseLookupTable rev_table;
   int syllable_id = 0;
   for (const string& syllable : syllabary) {
@@ -98,6 +97,14 @@ bool ReverseDb::Build(DictSettings* settings,
       rev_table[e->text].insert(syllable);
     }
   }
+  return Build(settings, rev_table, stems, dict_file_checksum);
+}
+
+bool ReverseDb::Build(DictSettings* settings,
+                      const ReverseLookupTable& rev_table,
+                      const ReverseLookupTable& stems,
+                      uint32_t dict_file_checksum) {
+  LOG(INFO) << "building reversedb...";
   StringTableBuilder key_trie_builder;
   StringTableBuilder value_trie_builder;
   size_t entry_count = rev_table.size() + stems.size();
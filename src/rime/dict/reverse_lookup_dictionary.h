@@ -49,6 +49,11 @@ class ReverseDb : public MappedFile {
              const Vocabulary& vocabulary,
              const ReverseLookupTable& stems,
              uint32_t dict_file_checksum);
+  // builds from the syllables of each word.
+  bool Build(DictSettings* settings,
+             const ReverseLookupTable& rev_table,
+             const ReverseLookupTable& stems,
+             uint32_t dict_file_checksum);
   bool Save();
 
   uint32_t dict_file_checksum() const;
@@ -53,15 +53,23 @@ void StringTable::Predict(const string& query, vector<StringId>* result) {
 }
 
 string StringTable::GetString(StringId string_id) {
+  string result;
+  GetString(string_id, &result);
+  return result;
+}
+
+bool StringTable::GetString(StringId string_id, string* result) {
   marisa::Agent agent;
   agent.set_query(string_id);
   try {
     trie_.reverse_lookup(agent);
   } catch (const marisa::Exception& /*ex*/) {
     LOG(ERROR) << "invalid id for string table: " << string_id;
-    return string();
+    result->clear();
+    return false;
   }
-  return string(agent.key().ptr(), agent.key().length());
+  result->assign(agent.key().ptr(), agent.key().length());
+  return true;
 }
 
 size_t StringTable::NumKeys() const {
@@ -30,6 +30,8 @@ class RIME_API StringTable {
   void CommonPrefixMatch(const string& query, vector<StringId>* result);
   void Predict(const string& query, vector<StringId>* result);
   string GetString(StringId string_id);
+  // writes the string to a caller-owned buffer, reusing its storage.
+  bool GetString(StringId string_id, string* result);
 
   size_t NumKeys() const;
   size_t BinarySize() const;
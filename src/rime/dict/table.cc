@@ -11,67 +11,105 @@
 #include <utility>
 #include <rime/common.h>
 #include <rime/algo/syllabifier.h>
+#include <rime/algo/utilities.h>
+#include <rime/dict/external_vocabulary.h>
 #include <rime/dict/table.h>
 
 namespace rime {
 
-const char kTableFormatLatest[] = "Rime::Table/4.0";
+const char kTableFormatLatest[] = "Rime::Table/5.0";
 const int kTableFormatLowestCompatible = 4.0;
+// the last format with entries of interleaved text ids and weights
+const char kTableFormatInterleaved[] = "Rime::Table/4.0";
+const int kTableFormatPacked = 5;
 
 const char kTableFormatPrefix[] = "Rime::Table/";
 const size_t kTableFormatPrefixLen = sizeof(kTableFormatPrefix) - 1;
 
+// words between the text ids or weights of adjacent entries in v4 tables
+static const size_t kEntryStride = sizeof(table::Entry) / sizeof(table::Weight);
+static const size_t kLongEntryStride =
+    sizeof(table::LongEntry) / sizeof(table::Weight);
+static_assert(sizeof(table::StringType) == sizeof(table::Weight),
+              "text ids and weights are counted in the same words.");
+
+static table::EntryView entry_view(const table::Entry* entries, size_t size) {
+  if (!entries)
+    return table::EntryView();
+  return table::EntryView(&entries->text, &entries->weight, size,
+                          kEntryStride);
+}
+
 TableAccessor::TableAccessor(const Code& index_code,
                              const List<table::Entry>* list,
                              double credibility)
     : index_code_(index_code),
-      entries_(list->at.get()),
-      size_(list->size),
+      entries_(entry_view(list->at.get(), list->size)),
+      interleaved_(true),
       credibility_(credibility) {}
 
 TableAccessor::TableAccessor(const Code& index_code,
                              const Array<table::Entry>* array,
                              double credibility)
     : index_code_(index_code),
-      entries_(array->at),
-      size_(array->size),
+      entries_(entry_view(array->at, array->size)),
+      interleaved_(true),
       credibility_(credibility) {}
 
 TableAccessor::TableAccessor(const Code& index_code,
                              const table::TailIndex* code_map,
                              double credibility)
     : index_code_(index_code),
-      long_entries_(code_map->at),
-      size_(code_map->size),
+      entries_(&code_map->at->entry.text,
+               &code_map->at->entry.weight,
+               code_map->size,
+               kLongEntryStride),
+      extra_codes_(&code_map->at->extra_code),
+      extra_code_stride_(sizeof(table::LongEntry) / sizeof(table::Code)),
+      interleaved_(true),
+      credibility_(credibility) {}
+
+TableAccessor::TableAccessor(const Code& index_code,
+                             const table::PackedEntries* entries,
+                             double credibility)
+    : index_code_(index_code),
+      entries_(entries->texts(), entries->weights.get(), entries->size, 1),
+      credibility_(credibility) {}
+
+TableAccessor::TableAccessor(const Code& index_code,
+                             const table::PackedTailIndex* tail_index,
+                             double credibility)
+    : index_code_(index_code),
+      entries_(tail_index->texts(),
+               tail_index->weights(),
+               tail_index->size,
+               1),
+      extra_codes_(tail_index->extra_codes),
       credibility_(credibility) {}
 
 bool TableAccessor::exhausted() const {
-  if (entries_ || long_entries_) {
-    return !(size_ - cursor_);
-  }
-  return true;
+  return cursor_ >= entries_.size();
 }
 
 size_t TableAccessor::remaining() const {
-  if (entries_ || long_entries_) {
-    return size_ - cursor_;
-  }
-  return 0;
+  return exhausted() ? 0 : entries_.size() - cursor_;
+}
+
+table::EntryView TableAccessor::entries() const {
+  return entries_.subview(cursor_);
 }
 
 const table::Entry* TableAccessor::entry() const {
-  if (exhausted())
-    return NULL;
-  if (entries_)
-    return &entries_[cursor_];
-  else
-    return &long_entries_[cursor_].entry;
+  if (!interleaved_ || exhausted())
+    return nullptr;
+  // the text id comes first in an entry
+  return reinterpret_cast<const table::Entry*>(&entries_.text(cursor_));
 }
 
 const table::Code* TableAccessor::extra_code() const {
-  if (!long_entries_ || cursor_ >= size_)
+  if (!extra_codes_ || exhausted())
     return NULL;
-  return &long_entries_[cursor_].extra_code;
+  return &extra_codes_[cursor_ * extra_code_stride_];
 }
 
 Code TableAccessor::code() const {
@@ -136,6 +174,8 @@ static table::TrunkIndexNode* find_node(table::TrunkIndexNode* first,
 }
 
 bool TableQuery::Walk(SyllableId syllable_id) {
+  if (packed_lv1_index_)
+    return WalkPacked(syllable_id);
   if (level_ == 0) {
     if (!lv1_index_ || syllable_id < 0 ||
         syllable_id >= static_cast<SyllableId>(lv1_index_->size))
@@ -175,6 +215,8 @@ inline static Code add_syllable(Code code, SyllableId syllable_id) {
 
 TableAccessor TableQuery::Access(SyllableId syllable_id,
                                  double credibility) const {
+  if (packed_lv1_index_)
+    return AccessPacked(syllable_id, credibility);
   credibility += credibility_.back();
   if (level_ == 0) {
     if (!lv1_index_ || syllable_id < 0 ||
@@ -202,6 +244,10 @@ TableAccessor TableQuery::Access(SyllableId syllable_id,
 
 void TableQuery::AccessAll(vector<TableAccessor>& accessors,
                            double credibility) {
+  if (packed_lv1_index_) {
+    AccessAllPacked(accessors, credibility);
+    return;
+  }
   credibility += credibility_.back();
   if (level_ == 0) {
     if (!lv1_index_)
@@ -272,6 +318,127 @@ void TableQuery::AccessAll(vector<TableAccessor>& accessors,
   }
 }
 
+// a lower bound search that moves the base of the range by a conditional
+// move rather than a branch, as mispredicted branches are the main cost of
+// searching short arrays of keys.
+static const table::PackedIndexNode* find_packed_node(
+    const table::PackedTrunkIndex* index,
+    SyllableId key) {
+  size_t size = index->size;
+  if (size == 0)
+    return nullptr;
+  const SyllableId* keys = index->keys;
+  const SyllableId* base = keys;
+  while (size > 1) {
+    size_t half = size / 2;
+    base = (base[half] < key) ? base + half : base;
+    size -= half;
+  }
+  base += (*base < key);
+  if (base == keys + index->size || *base != key)
+    return nullptr;
+  return &index->nodes()[base - keys];
+}
+
+bool TableQuery::WalkPacked(SyllableId syllable_id) {
+  if (level_ == 0) {
+    if (syllable_id < 0 ||
+        syllable_id >= static_cast<SyllableId>(packed_lv1_index_->size))
+      return false;
+    auto node = &packed_lv1_index_->at[syllable_id];
+    if (!node->next_level)
+      return false;
+    packed_lv2_index_ =
+        reinterpret_cast<table::PackedTrunkIndex*>(node->next_level.get());
+  } else if (level_ == 1 || level_ == 2) {
+    auto index = (level_ == 1) ? packed_lv2_index_ : packed_lv3_index_;
+    if (!index)
+      return false;
+    auto node = find_packed_node(index, syllable_id);
+    if (!node || !node->next_level)
+      return false;
+    if (level_ == 1)
+      packed_lv3_index_ =
+          reinterpret_cast<table::PackedTrunkIndex*>(node->next_level.get());
+    else
+      packed_lv4_index_ =
+          reinterpret_cast<table::PackedTailIndex*>(node->next_level.get());
+  } else {
+    return false;
+  }
+  return true;
+}
+
+TableAccessor TableQuery::AccessPacked(SyllableId syllable_id,
+                                       double credibility) const {
+  credibility += credibility_.back();
+  if (level_ == 0) {
+    if (syllable_id < 0 ||
+        syllable_id >= static_cast<SyllableId>(packed_lv1_index_->size))
+      return TableAccessor();
+    auto node = &packed_lv1_index_->at[syllable_id];
+    return TableAccessor(add_syllable(index_code_, syllable_id), &node->entries,
+                         credibility);
+  } else if (level_ == 1 || level_ == 2) {
+    auto index = (level_ == 1) ? packed_lv2_index_ : packed_lv3_index_;
+    if (!index)
+      return TableAccessor();
+    auto node = find_packed_node(index, syllable_id);
+    if (!node)
+      return TableAccessor();
+    return TableAccessor(add_syllable(index_code_, syllable_id), &node->entries,
+                         credibility);
+  } else if (level_ == 3) {
+    if (!packed_lv4_index_)
+      return TableAccessor();
+    return TableAccessor(index_code_, packed_lv4_index_, credibility);
+  }
+  return TableAccessor();
+}
+
+void TableQuery::AccessAllPacked(vector<TableAccessor>& accessors,
+                                 double credibility) {
+  credibility += credibility_.back();
+  if (level_ == 3) {
+    if (!packed_lv4_index_)
+      return;
+    TableAccessor accessor(index_code_, packed_lv4_index_, credibility);
+    if (!accessor.exhausted())
+      accessors.push_back(accessor);
+    return;
+  }
+  auto trunk = (level_ == 1) ? packed_lv2_index_ : packed_lv3_index_;
+  if (level_ > 0 && !trunk)
+    return;
+  size_t size = level_ == 0 ? packed_lv1_index_->size : trunk->size;
+  for (size_t i = 0; i < size; i++) {
+    SyllableId key = level_ == 0 ? static_cast<SyllableId>(i) : trunk->keys[i];
+    auto node = level_ == 0 ? &packed_lv1_index_->at[i] : &trunk->nodes()[i];
+    TableAccessor accessor(add_syllable(index_code_, key), &node->entries,
+                           credibility);
+    if (!accessor.exhausted())
+      accessors.push_back(accessor);
+    if (!node->next_level)
+      continue;
+    if (level_ == 0)
+      packed_lv2_index_ =
+          reinterpret_cast<table::PackedTrunkIndex*>(node->next_level.get());
+    else if (level_ == 1)
+      packed_lv3_index_ =
+          reinterpret_cast<table::PackedTrunkIndex*>(node->next_level.get());
+    else
+      packed_lv4_index_ =
+          reinterpret_cast<table::PackedTailIndex*>(node->next_level.get());
+    ++level_;
+    index_code_.push_back(key);
+    credibility_.push_back(credibility);
+    AccessAllPacked(accessors, credibility);
+    --level_;
+    index_code_.pop_back();
+    credibility_.pop_back();
+  }
+}
+
 // string Table::GetString_v1(const table::StringType& x) {
 //  return x.str().c_str();
 // }
@@ -351,6 +518,7 @@ bool Table::Load() {
                << kTableFormatLatest;
     return false;
   }
+  format_version_ = static_cast<int>(format_version + DBL_EPSILON);
 
   syllabary_ = metadata_->syllabary.get();
   if (!syllabary_) {
@@ -358,8 +526,13 @@ bool Table::Load() {
     Close();
     return false;
   }
-  index_ = metadata_->index.get();
-  if (!index_) {
+  index_ = nullptr;
+  packed_index_ = nullptr;
+  if (format_version_ >= kTableFormatPacked)
+    packed_index_ = metadata_->packed_index.get();
+  else
+    index_ = metadata_->index.get();
+  if (!index_ && !packed_index_) {
     LOG(ERROR) << "table index not found.";
     Close();
     return false;
@@ -371,7 +544,7 @@ bool Table::Load() {
 bool Table::Save() {
   LOG(INFO) << "saving table file: " << file_path();
 
-  if (!index_) {
+  if (!index_ && !packed_index_) {
     LOG(ERROR) << "the table has not been constructed!";
     return false;
   }
@@ -383,10 +556,73 @@ uint32_t Table::dict_file_checksum() const {
   return metadata_ ? metadata_->dict_file_checksum : 0;
 }
 
+static uint32_t checksum_syllabary(const Syllabary& syllabary) {
+  ChecksumComputer cc;
+  for (const string& syllable : syllabary) {
+    // including the terminating null character as a separator
+    cc.ProcessBytes(syllable.c_str(), syllable.length() + 1);
+  }
+  return cc.Checksum();
+}
+
+uint32_t Table::syllabary_checksum() {
+  if (!metadata_)
+    return 0;
+  if (metadata_->syllabary_checksum)
+    return metadata_->syllabary_checksum;
+  Syllabary syllabary;
+  GetSyllabary(&syllabary);
+  return checksum_syllabary(syllabary);
+}
+
+TableSources Table::GetSources() const {
+  TableSources sources;
+  if (!metadata_ || !metadata_->source_checksums)
+    return sources;
+  for (const auto& source : *metadata_->source_checksums) {
+    sources.emplace_back(source.name.c_str(), source.checksum);
+  }
+  return sources;
+}
+
 bool Table::Build(const Syllabary& syllabary,
                   const Vocabulary& vocabulary,
                   size_t num_entries,
                   uint32_t dict_file_checksum) {
+  if (!StartBuild(syllabary, num_entries, dict_file_checksum))
+    return false;
+  LOG(INFO) << "creating table index.";
+  if (format_version_ >= kTableFormatPacked)
+    packed_index_ = BuildPackedHeadIndex(vocabulary, syllabary.size());
+  else
+    index_ = BuildIndex(vocabulary, syllabary.size());
+  return FinishBuild();
+}
+
+bool Table::Build(const Syllabary& syllabary,
+                  const ExternalVocabulary& vocabulary,
+                  size_t num_entries,
+                  uint32_t dict_file_checksum) {
+  if (!StartBuild(syllabary, num_entries, dict_file_checksum))
+    return false;
+  LOG(INFO) << "creating table index from merged entries.";
+  ExternalVocabularyReader reader(vocabulary);
+  if (format_version_ >= kTableFormatPacked)
+    packed_index_ = BuildPackedHeadIndex(&reader, syllabary.size());
+  else
+    index_ = reinterpret_cast<table::Index*>(
+        BuildHeadIndex(&reader, syllabary.size()));
+  if ((index_ || packed_index_) && !reader.exhausted()) {
+    LOG(ERROR) << "unexpected entry '" << reader.entry().text << "'.";
+    index_ = nullptr;
+    packed_index_ = nullptr;
+  }
+  return FinishBuild();
+}
+
+bool Table::StartBuild(const Syllabary& syllabary,
+                       size_t num_entries,
+                       uint32_t dict_file_checksum) {
   const size_t kReservedSize = 4096;
   size_t num_syllables = syllabary.size();
   size_t estimated_file_size =
@@ -407,6 +643,7 @@ bool Table::Build(const Syllabary& syllabary,
     return false;
   }
   metadata_->dict_file_checksum = dict_file_checksum;
+  metadata_->syllabary_checksum = checksum_syllabary(syllabary);
   metadata_->num_syllables = num_syllables;
   metadata_->num_entries = num_entries;
 
@@ -427,20 +664,39 @@ bool Table::Build(const Syllabary& syllabary,
   }
   metadata_->syllabary = syllabary_;
 
-  LOG(INFO) << "creating table index.";
-  index_ = BuildIndex(vocabulary, num_syllables);
-  if (!index_) {
+  if (!sources_.empty()) {
+    auto sources = CreateArray<table::SourceChecksum>(sources_.size());
+    if (!sources) {
+      LOG(ERROR) << "Error creating source checksums.";
+      return false;
+    }
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      if (!CopyString(sources_[i].first, &sources->at[i].name))
+        return false;
+      sources->at[i].checksum = sources_[i].second;
+    }
+    metadata_->source_checksums = sources;
+  }
+  return true;
+}
+
+bool Table::FinishBuild() {
+  if (!index_ && !packed_index_) {
     LOG(ERROR) << "Error creating table index.";
     return false;
   }
-  metadata_->index = index_;
+  if (index_)
+    metadata_->index = index_;
+  else
+    metadata_->packed_index = packed_index_;
 
   if (!OnBuildFinish()) {
     return false;
   }
 
   // at last, complete the metadata
-  std::strncpy(metadata_->format, kTableFormatLatest,
+  std::strncpy(metadata_->format,
+               packed_index_ ? kTableFormatLatest : kTableFormatInterleaved,
                table::Metadata::kFormatMaxLength);
   return true;
 }
@@ -588,6 +844,382 @@ bool Table::BuildEntry(const ShortDictEntry& dict_entry, table::Entry* entry) {
   return true;
 }
 
+// the reader yields entries in the order they are laid out, and the size of
+// each node or entry list before its contents.
+
+table::HeadIndex* Table::BuildHeadIndex(ExternalVocabularyReader* reader,
+                                        size_t num_syllables) {
+  auto index = CreateArray<table::HeadIndexNode>(num_syllables);
+  if (!index) {
+    return NULL;
+  }
+  while (!reader->exhausted()) {
+    Code code;
+    code.push_back(reader->entry().code[0]);
+    int syllable_id = code.back();
+    if (syllable_id < 0 || syllable_id >= static_cast<int>(num_syllables)) {
+      LOG(ERROR) << "invalid syllable id: " << syllable_id;
+      return NULL;
+    }
+    auto& node(index->at[syllable_id]);
+    if (!BuildEntryList(reader, &node.entries)) {
+      return NULL;
+    }
+    if (reader->HasPrefix(code)) {
+      auto next_level_index = BuildTrunkIndex(code, reader);
+      if (!next_level_index) {
+        return NULL;
+      }
+      node.next_level = reinterpret_cast<table::PhraseIndex*>(next_level_index);
+    }
+  }
+  return index;
+}
+
+table::TrunkIndex* Table::BuildTrunkIndex(const Code& prefix,
+                                          ExternalVocabularyReader* reader) {
+  auto index = CreateArray<table::TrunkIndexNode>(reader->NextCount());
+  if (!index) {
+    return NULL;
+  }
+  size_t count = 0;
+  while (reader->HasPrefix(prefix)) {
+    if (count == index->size) {
+      LOG(ERROR) << "too many nodes in trunk index: " << prefix.ToString();
+      return NULL;
+    }
+    Code code(prefix);
+    code.push_back(reader->entry().code[prefix.size()]);
+    auto& node(index->at[count++]);
+    node.key = code.back();
+    if (!BuildEntryList(reader, &node.entries)) {
+      return NULL;
+    }
+    if (reader->HasPrefix(code)) {
+      if (code.size() < Code::kIndexCodeMaxLength) {
+        auto next_level_index = BuildTrunkIndex(code, reader);
+        if (!next_level_index) {
+          return NULL;
+        }
+        node.next_level =
+            reinterpret_cast<table::PhraseIndex*>(next_level_index);
+      } else {
+        auto tail_index = BuildTailIndex(reader);
+        if (!tail_index) {
+          return NULL;
+        }
+        node.next_level = reinterpret_cast<table::PhraseIndex*>(tail_index);
+      }
+    }
+  }
+  return index;
+}
+
+table::TailIndex* Table::BuildTailIndex(ExternalVocabularyReader* reader) {
+  auto index = CreateArray<table::LongEntry>(reader->NextCount());
+  if (!index) {
+    return NULL;
+  }
+  for (auto& dest : *index) {
+    if (reader->exhausted())
+      return NULL;
+    const auto& src(reader->entry());
+    size_t extra_code_length = src.code.size() - Code::kIndexCodeMaxLength;
+    dest.extra_code.size = extra_code_length;
+    dest.extra_code.at = Allocate<SyllableId>(extra_code_length);
+    if (!dest.extra_code.at) {
+      LOG(ERROR) << "Error creating code sequence; file size: " << file_size();
+      return NULL;
+    }
+    std::copy(src.code.begin() + Code::kIndexCodeMaxLength, src.code.end(),
+              dest.extra_code.begin());
+    BuildEntry(src, &dest.entry);
+    reader->Next();
+  }
+  return index;
+}
+
+bool Table::BuildEntryList(ExternalVocabularyReader* reader,
+                           List<table::Entry>* dest) {
+  if (!dest)
+    return false;
+  dest->size = reader->NextCount();
+  dest->at = Allocate<table::Entry>(dest->size);
+  if (!dest->at) {
+    LOG(ERROR) << "Error creating table entries; file size: " << file_size();
+    return false;
+  }
+  for (auto& entry : *dest) {
+    if (reader->exhausted() || !BuildEntry(reader->entry(), &entry))
+      return false;
+    reader->Next();
+  }
+  return true;
+}
+
+// v5 tables are built in the same order, with the keys of each trunk index
+// and the weights and text ids of each list of entries in separate arrays.
+
+bool Table::AllocatePackedEntries(size_t size, table::PackedEntries* dest) {
+  dest->size = size;
+  if (size == 0)
+    return true;
+  static_assert(alignof(table::StringType) <= alignof(table::Weight),
+                "text ids follow the weights unpadded.");
+  // the text ids follow in the same block
+  auto weights = Allocate<table::Weight>(size * 2);
+  if (!weights) {
+    LOG(ERROR) << "Error creating table entries; file size: " << file_size();
+    return false;
+  }
+  dest->weights = weights;
+  return true;
+}
+
+// the keys and nodes of a trunk index, or the codes and entries of a tail
+// index, are allocated in one block after the size.
+
+table::PackedTrunkIndex* Table::CreatePackedTrunkIndex(size_t size) {
+  size_t num_words =
+      1 + size * (sizeof(SyllableId) + sizeof(table::PackedIndexNode)) /
+              sizeof(uint32_t);
+  auto index = reinterpret_cast<table::PackedTrunkIndex*>(
+      Allocate<uint32_t>(num_words));
+  if (index)
+    index->size = size;
+  return index;
+}
+
+table::PackedTailIndex* Table::CreatePackedTailIndex(size_t size) {
+  size_t num_words =
+      1 + size *
+              (sizeof(table::Code) + sizeof(table::Weight) +
+               sizeof(table::StringType)) /
+              sizeof(uint32_t);
+  auto index = reinterpret_cast<table::PackedTailIndex*>(
+      Allocate<uint32_t>(num_words));
+  if (index)
+    index->size = size;
+  return index;
+}
+
+bool Table::CopyExtraCode(const Code& code, table::Code* dest) {
+  size_t extra_code_length = code.size() - Code::kIndexCodeMaxLength;
+  dest->size = extra_code_length;
+  dest->at = Allocate<SyllableId>(extra_code_length);
+  if (!dest->at) {
+    LOG(ERROR) << "Error creating code sequence; file size: " << file_size();
+    return false;
+  }
+  std::copy(code.begin() + Code::kIndexCodeMaxLength, code.end(),
+            dest->begin());
+  return true;
+}
+
+bool Table::BuildPackedEntries(const ShortDictEntryList& src,
+                               table::PackedEntries* dest) {
+  if (!AllocatePackedEntries(src.size(), dest))
+    return false;
+  for (size_t i = 0; i < src.size(); ++i) {
+    dest->weights[i] = static_cast<table::Weight>(src[i]->weight);
+    if (!AddString(src[i]->text, &dest->texts()[i], src[i]->weight))
+      return false;
+  }
+  return true;
+}
+
+table::PackedHeadIndex* Table::BuildPackedHeadIndex(
+    const Vocabulary& vocabulary,
+    size_t num_syllables) {
+  auto index = CreateArray<table::PackedIndexNode>(num_syllables);
+  if (!index) {
+    return NULL;
+  }
+  for (const auto& v : vocabulary) {
+    int syllable_id = v.first;
+    auto& node(index->at[syllable_id]);
+    if (!BuildPackedEntries(v.second.entries, &node.entries)) {
+      return NULL;
+    }
+    if (v.second.next_level) {
+      Code code;
+      code.push_back(syllable_id);
+      auto next_level_index = BuildPackedTrunkIndex(code, *v.second.next_level);
+      if (!next_level_index) {
+        return NULL;
+      }
+      node.next_level = reinterpret_cast<table::PhraseIndex*>(next_level_index);
+    }
+  }
+  return index;
+}
+
+table::PackedTrunkIndex* Table::BuildPackedTrunkIndex(
+    const Code& prefix,
+    const Vocabulary& vocabulary) {
+  auto index = CreatePackedTrunkIndex(vocabulary.size());
+  if (!index) {
+    return NULL;
+  }
+  auto keys = index->keys;
+  auto nodes = index->nodes();
+  size_t count = 0;
+  for (const auto& v : vocabulary) {
+    int syllable_id = v.first;
+    keys[count] = syllable_id;
+    auto& node(nodes[count++]);
+    if (!BuildPackedEntries(v.second.entries, &node.entries)) {
+      return NULL;
+    }
+    if (v.second.next_level) {
+      Code code(prefix);
+      code.push_back(syllable_id);
+      table::PhraseIndex* next_level_index;
+      if (code.size() < Code::kIndexCodeMaxLength) {
+        next_level_index = reinterpret_cast<table::PhraseIndex*>(
+            BuildPackedTrunkIndex(code, *v.second.next_level));
+      } else {
+        next_level_index = reinterpret_cast<table::PhraseIndex*>(
+            BuildPackedTailIndex(*v.second.next_level));
+      }
+      if (!next_level_index) {
+        return NULL;
+      }
+      node.next_level = next_level_index;
+    }
+  }
+  return index;
+}
+
+table::PackedTailIndex* Table::BuildPackedTailIndex(
+    const Vocabulary& vocabulary) {
+  if (vocabulary.find(-1) == vocabulary.end()) {
+    return NULL;
+  }
+  const auto& entries(vocabulary.find(-1)->second.entries);
+  auto index = CreatePackedTailIndex(entries.size());
+  if (!index) {
+    return NULL;
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto& src(*entries[i]);
+    if (!CopyExtraCode(src.code, &index->extra_codes[i]))
+      return NULL;
+    index->weights()[i] = static_cast<table::Weight>(src.weight);
+    if (!AddString(src.text, &index->texts()[i], src.weight))
+      return NULL;
+  }
+  return index;
+}
+
+bool Table::BuildPackedEntries(ExternalVocabularyReader* reader,
+                               table::PackedEntries* dest) {
+  if (!AllocatePackedEntries(reader->NextCount(), dest))
+    return false;
+  for (size_t i = 0; i < dest->size; ++i) {
+    if (reader->exhausted())
+      return false;
+    const auto& src(reader->entry());
+    dest->weights[i] = static_cast<table::Weight>(src.weight);
+    if (!AddString(src.text, &dest->texts()[i], src.weight))
+      return false;
+    reader->Next();
+  }
+  return true;
+}
+
+table::PackedHeadIndex* Table::BuildPackedHeadIndex(
+    ExternalVocabularyReader* reader,
+    size_t num_syllables) {
+  auto index = CreateArray<table::PackedIndexNode>(num_syllables);
+  if (!index) {
+    return NULL;
+  }
+  while (!reader->exhausted()) {
+    Code code;
+    code.push_back(reader->entry().code[0]);
+    int syllable_id = code.back();
+    if (syllable_id < 0 || syllable_id >= static_cast<int>(num_syllables)) {
+      LOG(ERROR) << "invalid syllable id: " << syllable_id;
+      return NULL;
+    }
+    auto& node(index->at[syllable_id]);
+    if (!BuildPackedEntries(reader, &node.entries)) {
+      return NULL;
+    }
+    if (reader->HasPrefix(code)) {
+      auto next_level_index = BuildPackedTrunkIndex(code, reader);
+      if (!next_level_index) {
+        return NULL;
+      }
+      node.next_level = reinterpret_cast<table::PhraseIndex*>(next_level_index);
+    }
+  }
+  return index;
+}
+
+table::PackedTrunkIndex* Table::BuildPackedTrunkIndex(
+    const Code& prefix,
+    ExternalVocabularyReader* reader) {
+  size_t size = reader->NextCount();
+  auto index = CreatePackedTrunkIndex(size);
+  if (!index) {
+    return NULL;
+  }
+  auto keys = index->keys;
+  auto nodes = index->nodes();
+  size_t count = 0;
+  while (reader->HasPrefix(prefix)) {
+    if (count == size) {
+      LOG(ERROR) << "too many nodes in trunk index: " << prefix.ToString();
+      return NULL;
+    }
+    Code code(prefix);
+    code.push_back(reader->entry().code[prefix.size()]);
+    keys[count] = code.back();
+    auto& node(nodes[count++]);
+    if (!BuildPackedEntries(reader, &node.entries)) {
+      return NULL;
+    }
+    if (reader->HasPrefix(code)) {
+      table::PhraseIndex* next_level_index;
+      if (code.size() < Code::kIndexCodeMaxLength) {
+        next_level_index = reinterpret_cast<table::PhraseIndex*>(
+            BuildPackedTrunkIndex(code, reader));
+      } else {
+        next_level_index = reinterpret_cast<table::PhraseIndex*>(
+            BuildPackedTailIndex(reader));
+      }
+      if (!next_level_index) {
+        return NULL;
+      }
+      node.next_level = next_level_index;
+    }
+  }
+  return index;
+}
+
+table::PackedTailIndex* Table::BuildPackedTailIndex(
+    ExternalVocabularyReader* reader) {
+  size_t size = reader->NextCount();
+  auto index = CreatePackedTailIndex(size);
+  if (!index) {
+    return NULL;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    if (reader->exhausted())
+      return NULL;
+    const auto& src(reader->entry());
+    if (!CopyExtraCode(src.code, &index->extra_codes[i]))
+      return NULL;
+    index->weights()[i] = static_cast<table::Weight>(src.weight);
+    if (!AddString(src.text, &index->texts()[i], src.weight))
+      return NULL;
+    reader->Next();
+  }
+  return index;
+}
+
 bool Table::GetSyllabary(Syllabary* result) {
   if (!result || !syllabary_)
     return false;
@@ -604,14 +1236,14 @@ string Table::GetSyllableById(SyllableId syllable_id) {
 }
 
 TableAccessor Table::QueryWords(SyllableId syllable_id) {
-  TableQuery query(index_);
+  TableQuery query(NewQuery());
   return query.Access(syllable_id);
 }
 
 TableAccessor Table::QueryPhrases(const Code& code) {
   if (code.empty())
     return TableAccessor();
-  TableQuery query(index_);
+  TableQuery query(NewQuery());
   for (size_t i = 0; i < Code::kIndexCodeMaxLength; ++i) {
     if (code.size() == i + 1)
       return query.Access(code[i]);
@@ -626,12 +1258,13 @@ bool Table::Query(const SyllableGraph& syll_graph,
                   TableQueryResult* result,
                   bool predict_word,
                   bool with_correction) {
-  if (!result || !index_ || start_pos >= syll_graph.interpreted_length)
+  if (!result || (!index_ && !packed_index_) ||
+      start_pos >= syll_graph.interpreted_length)
     return false;
   result->clear();
   std::queue<QueryQueue> q;
   std::vector<TableQuery> deferred;
-  TableQuery initial_state(index_);
+  TableQuery initial_state(NewQuery());
   q.push({start_pos, initial_state, true, false});
   while (!q.empty()) {
     size_t current_pos = q.front().pos;
@@ -652,7 +1285,6 @@ bool Table::Query(const SyllableGraph& syll_graph,
       }
       continue;
     }
-    auto& index = syll_graph.indices[current_pos];
     if (query.level() == Code::kIndexCodeMaxLength) {
       TableAccessor accessor(query.Access(-1));
       if (!accessor.exhausted()) {
@@ -660,20 +1292,21 @@ bool Table::Query(const SyllableGraph& syll_graph,
       }
       continue;
     }
-    for (const auto& spellings : index) {
-      SyllableId syll_id = spellings.first;
-      for (auto props : spellings.second) {
+    const auto& index = syll_graph.indices;
+    for (const auto& syllable : index.syllables(current_pos)) {
+      SyllableId syll_id = syllable.syllable_id;
+      for (const auto& props : index.spellings(syllable)) {
         if (!with_correction &&
-            (props->is_correction || props->type == kCompletion))
+            (props.is_correction || props.type == kCompletion))
           continue;
-        TableAccessor accessor(query.Access(syll_id, props->credibility));
-        size_t end_pos = props->end_pos;
+        TableAccessor accessor(query.Access(syll_id, props.credibility));
+        size_t end_pos = props.end_pos;
         if (!accessor.exhausted()) {
           (*result)[end_pos].push_back(accessor);
         }
-        if (query.Advance(syll_id, props->credibility)) {
+        if (query.Advance(syll_id, props.credibility)) {
           q.push({end_pos, query,
-                  isRegularSpelling && props->type == kNormalSpelling,
+                  isRegularSpelling && props.type == kNormalSpelling,
                   accessor.exhausted()});
           query.Backdate();
         }
@@ -691,8 +1324,20 @@ bool Table::Query(const SyllableGraph& syll_graph,
   return !result->empty();
 }
 
+string Table::GetEntryText(const table::StringType& text_id) {
+  return GetString(text_id);
+}
+
+bool Table::GetEntryText(const table::StringType& text_id, string* text) {
+  return string_table_->GetString(text_id.str_id(), text);
+}
+
 string Table::GetEntryText(const table::Entry& entry) {
-  return GetString(entry.text);
+  return GetEntryText(entry.text);
+}
+
+bool Table::GetEntryText(const table::Entry& entry, string* text) {
+  return GetEntryText(entry.text, text);
 }
 
 }  // namespace rime
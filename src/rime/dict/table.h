@@ -84,6 +84,93 @@ RIME_TABLE_UNION(PhraseIndex, Array<char>, TrunkIndex, trunk, TailIndex, tail);
 
 using Index = HeadIndex;
 
+// v5
+// text ids and weights of entries are kept in separate arrays, so that
+// ranking entries by weight does not pull their texts into cache.
+struct PackedEntries {
+  uint32_t size;
+  // followed by as many text ids
+  OffsetPtr<Weight> weights;
+
+  StringType* texts() const {
+    return reinterpret_cast<StringType*>(weights.get() + size);
+  }
+};
+
+struct PackedIndexNode {
+  PackedEntries entries;
+  OffsetPtr<PhraseIndex> next_level;
+};
+
+using PackedHeadIndex = Array<PackedIndexNode>;
+
+// keys are stored contiguously, followed by the nodes they lead to, so that
+// a search touches nothing but the keys.
+struct PackedTrunkIndex {
+  uint32_t size;
+  SyllableId keys[1];
+
+  PackedIndexNode* nodes() {
+    return reinterpret_cast<PackedIndexNode*>(keys + size);
+  }
+  const PackedIndexNode* nodes() const {
+    return reinterpret_cast<const PackedIndexNode*>(keys + size);
+  }
+};
+
+// extra codes of the entries, followed by their weights and text ids.
+struct PackedTailIndex {
+  uint32_t size;
+  Code extra_codes[1];
+
+  Weight* weights() { return reinterpret_cast<Weight*>(extra_codes + size); }
+  const Weight* weights() const {
+    return reinterpret_cast<const Weight*>(extra_codes + size);
+  }
+  StringType* texts() {
+    return reinterpret_cast<StringType*>(weights() + size);
+  }
+  const StringType* texts() const {
+    return reinterpret_cast<const StringType*>(weights() + size);
+  }
+};
+
+// a list of entries read in place from either format. the text id or weight
+// of each entry is `stride` words after that of the previous one.
+class EntryView {
+ public:
+  EntryView() = default;
+  EntryView(const StringType* texts,
+            const Weight* weights,
+            size_t size,
+            size_t stride)
+      : texts_(texts), weights_(weights), size_(size), stride_(stride) {}
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const StringType& text(size_t i) const { return texts_[i * stride_]; }
+  Weight weight(size_t i) const { return weights_[i * stride_]; }
+  // the entries from position pos on.
+  EntryView subview(size_t pos) const {
+    return pos < size_ ? EntryView(&text(pos), &weights_[pos * stride_],
+                                   size_ - pos, stride_)
+                       : EntryView();
+  }
+
+ private:
+  const StringType* texts_ = nullptr;
+  const Weight* weights_ = nullptr;
+  size_t size_ = 0;
+  size_t stride_ = 1;
+};
+
+struct SourceChecksum {
+  String name;
+  uint32_t checksum;
+};
+
+using SourceChecksums = Array<SourceChecksum>;
+
 struct Metadata {
   static const int kFormatMaxLength = 32;
   char format[kFormatMaxLength];
@@ -93,10 +180,15 @@ struct Metadata {
   OffsetPtr<Syllabary> syllabary;
   OffsetPtr<Index> index;
   // v2
-  int32_t reserved_1;
-  int32_t reserved_2;
+  // both were reserved and left zero in tables built earlier
+  uint32_t syllabary_checksum;
+  OffsetPtr<SourceChecksums> source_checksums;
   OffsetPtr<char> string_table;
   uint32_t string_table_size;
+  // v5
+  // index is left null in the packed layout, so that loaders of earlier
+  // versions reject the table.
+  OffsetPtr<PackedHeadIndex> packed_index;
 };
 
 }  // namespace table
@@ -113,12 +205,23 @@ class TableAccessor {
   TableAccessor(const Code& index_code,
                 const table::TailIndex* code_map,
                 double credibility = 0.0);
+  TableAccessor(const Code& index_code,
+                const table::PackedEntries* entries,
+                double credibility = 0.0);
+  TableAccessor(const Code& index_code,
+                const table::PackedTailIndex* tail_index,
+                double credibility = 0.0);
 
   RIME_API bool Next();
 
   RIME_API bool exhausted() const;
   RIME_API size_t remaining() const;
+  // the remaining entries, from the current one on.
+  RIME_API table::EntryView entries() const;
+  // the current entry of a table in format v4; null in later formats.
   RIME_API const table::Entry* entry() const;
+  const table::StringType& text() const { return entries_.text(cursor_); }
+  table::Weight weight() const { return entries_.weight(cursor_); }
   RIME_API const table::Code* extra_code() const;
   const Code& index_code() const { return index_code_; }
   Code code() const;
@@ -126,9 +229,11 @@ class TableAccessor {
 
  private:
   Code index_code_;
-  const table::Entry* entries_ = nullptr;
-  const table::LongEntry* long_entries_ = nullptr;
-  size_t size_ = 0;
+  table::EntryView entries_;
+  const table::Code* extra_codes_ = nullptr;
+  size_t extra_code_stride_ = 1;
+  // the entries are table::Entry records
+  bool interleaved_ = false;
   size_t cursor_ = 0;
   double credibility_ = 0.0;
 };
@@ -136,10 +241,15 @@ class TableAccessor {
 using TableQueryResult = map<int, vector<TableAccessor>>;
 
 struct SyllableGraph;
+class ExternalVocabulary;
+class ExternalVocabularyReader;
 
 class TableQuery {
  public:
   TableQuery(table::Index* index) : lv1_index_(index) { Reset(); }
+  TableQuery(table::PackedHeadIndex* index) : packed_lv1_index_(index) {
+    Reset();
+  }
 
   TableAccessor Access(SyllableId syllable_id, double credibility = 0.0) const;
   void AccessAll(vector<TableAccessor>& accessors, double credibility = 0.0);
@@ -162,11 +272,19 @@ class TableQuery {
 
  private:
   bool Walk(SyllableId syllable_id);
+  bool WalkPacked(SyllableId syllable_id);
+  TableAccessor AccessPacked(SyllableId syllable_id, double credibility) const;
+  void AccessAllPacked(vector<TableAccessor>& accessors, double credibility);
 
   table::HeadIndex* lv1_index_ = nullptr;
   table::TrunkIndex* lv2_index_ = nullptr;
   table::TrunkIndex* lv3_index_ = nullptr;
   table::TailIndex* lv4_index_ = nullptr;
+  // v5
+  table::PackedHeadIndex* packed_lv1_index_ = nullptr;
+  table::PackedTrunkIndex* packed_lv2_index_ = nullptr;
+  table::PackedTrunkIndex* packed_lv3_index_ = nullptr;
+  table::PackedTailIndex* packed_lv4_index_ = nullptr;
 };
 
 class Table : public MappedFile {
@@ -180,6 +298,11 @@ class Table : public MappedFile {
                       const Vocabulary& vocabulary,
                       size_t num_entries,
                       uint32_t dict_file_checksum = 0);
+  // builds from merged entries, holding only a few of them in memory.
+  RIME_API bool Build(const Syllabary& syllabary,
+                      const ExternalVocabulary& vocabulary,
+                      size_t num_entries,
+                      uint32_t dict_file_checksum = 0);
 
   bool GetSyllabary(Syllabary* syllabary);
   RIME_API string GetSyllableById(int syllable_id);
@@ -190,12 +313,34 @@ class Table : public MappedFile {
                       TableQueryResult* result,
                       bool predict_word = false,
                       bool with_correction = false);
+  RIME_API string GetEntryText(const table::StringType& text_id);
+  RIME_API bool GetEntryText(const table::StringType& text_id, string* text);
   RIME_API string GetEntryText(const table::Entry& entry);
+  RIME_API bool GetEntryText(const table::Entry& entry, string* text);
+  // a query at the root of the index, in the format of the table.
+  TableQuery NewQuery() const {
+    return packed_index_ ? TableQuery(packed_index_) : TableQuery(index_);
+  }
 
   uint32_t dict_file_checksum() const;
+  // computed from the syllabary of tables that have not recorded it.
+  uint32_t syllabary_checksum();
+  // source files recorded in the table; empty for tables built earlier.
+  TableSources GetSources() const;
+  // sets source files to be recorded in the table being built.
+  void set_sources(const TableSources& sources) { sources_ = sources; }
   table::Metadata* metadata() const { return metadata_; }
+  // the major version of the table format. tables are built in format v4,
+  // which older versions of the library can read, unless set to 5.
+  static const int kDefaultFormatVersion = 4;
+  int format_version() const { return format_version_; }
+  void set_format_version(int version) { format_version_ = version; }
 
  private:
+  bool StartBuild(const Syllabary& syllabary,
+                  size_t num_entries,
+                  uint32_t dict_file_checksum);
+  bool FinishBuild();
   table::Index* BuildIndex(const Vocabulary& vocabulary, size_t num_syllables);
   table::HeadIndex* BuildHeadIndex(const Vocabulary& vocabulary,
                                    size_t num_syllables);
@@ -209,6 +354,34 @@ class Table : public MappedFile {
   Array<table::Entry>* BuildEntryArray(const ShortDictEntryList& entries);
   bool BuildEntryList(const ShortDictEntryList& src, List<table::Entry>* dest);
   bool BuildEntry(const ShortDictEntry& dict_entry, table::Entry* entry);
+  table::HeadIndex* BuildHeadIndex(ExternalVocabularyReader* reader,
+                                   size_t num_syllables);
+  table::TrunkIndex* BuildTrunkIndex(const Code& prefix,
+                                     ExternalVocabularyReader* reader);
+  table::TailIndex* BuildTailIndex(ExternalVocabularyReader* reader);
+  bool BuildEntryList(ExternalVocabularyReader* reader,
+                      List<table::Entry>* dest);
+  // v5
+  table::PackedHeadIndex* BuildPackedHeadIndex(const Vocabulary& vocabulary,
+                                               size_t num_syllables);
+  table::PackedTrunkIndex* BuildPackedTrunkIndex(const Code& prefix,
+                                                 const Vocabulary& vocabulary);
+  table::PackedTailIndex* BuildPackedTailIndex(const Vocabulary& vocabulary);
+  bool BuildPackedEntries(const ShortDictEntryList& src,
+                          table::PackedEntries* dest);
+  table::PackedHeadIndex* BuildPackedHeadIndex(ExternalVocabularyReader* reader,
+                                               size_t num_syllables);
+  table::PackedTrunkIndex* BuildPackedTrunkIndex(
+      const Code& prefix,
+      ExternalVocabularyReader* reader);
+  table::PackedTailIndex* BuildPackedTailIndex(
+      ExternalVocabularyReader* reader);
+  bool BuildPackedEntries(ExternalVocabularyReader* reader,
+                          table::PackedEntries* dest);
+  bool AllocatePackedEntries(size_t size, table::PackedEntries* dest);
+  table::PackedTrunkIndex* CreatePackedTrunkIndex(size_t size);
+  table::PackedTailIndex* CreatePackedTailIndex(size_t size);
+  bool CopyExtraCode(const Code& code, table::Code* dest);
 
   string GetString(const table::StringType& x);
   bool AddString(const string& src, table::StringType* dest, double weight);
@@ -220,9 +393,12 @@ class Table : public MappedFile {
   table::Metadata* metadata_ = nullptr;
   table::Syllabary* syllabary_ = nullptr;
   table::Index* index_ = nullptr;
+  table::PackedHeadIndex* packed_index_ = nullptr;
+  int format_version_ = kDefaultFormatVersion;
 
   the<StringTable> string_table_;
   the<StringTableBuilder> string_table_builder_;
+  TableSources sources_;
 };
 
 struct QueryQueue {
@@ -4,7 +4,9 @@
 //
 // 2011-11-02 GONG Chen <chen.sst@gmail.com>
 //
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
 #include <rime/service.h>
@@ -32,6 +34,102 @@ void UserDbValue::AppendElements(const DictEntry& entry) {
   }
 }
 
+// binary value ::= tag version commits:int32 dee:float64 tick:uint64
+//                  count:varint { length:varint bytes }
+// with fixed-width fields in little endian. text values never begin with
+// the tag.
+static const char kBinaryValueTag = '\0';
+static const char kBinaryValueVersion = 1;
+static const size_t kBinaryValueHeaderSize = 2 + 4 + 8 + 8;
+
+static void put_fixed(string* out, uint64_t x, size_t width) {
+  for (size_t i = 0; i < width; ++i) {
+    out->push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+  }
+}
+
+static uint64_t get_fixed(const char* p, size_t width) {
+  uint64_t x = 0;
+  for (size_t i = 0; i < width; ++i) {
+    x |= uint64_t(static_cast<uint8_t>(p[i])) << (8 * i);
+  }
+  return x;
+}
+
+static void put_varint(string* out, size_t x) {
+  while (x >= 0x80) {
+    out->push_back(static_cast<char>((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  out->push_back(static_cast<char>(x));
+}
+
+static bool get_varint(const string& in, size_t* pos, size_t* x) {
+  *x = 0;
+  for (int shift = 0; *pos < in.length() && shift < 64; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(in[(*pos)++]);
+    *x |= size_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool UserDbValue::IsBinary(const string& value) {
+  return !value.empty() && value[0] == kBinaryValueTag;
+}
+
+string UserDbValue::PackBinary() const {
+  string packed;
+  packed.reserve(kBinaryValueHeaderSize + 1);
+  packed.push_back(kBinaryValueTag);
+  packed.push_back(kBinaryValueVersion);
+  put_fixed(&packed, static_cast<uint32_t>(commits), 4);
+  uint64_t dee_bits;
+  std::memcpy(&dee_bits, &dee, sizeof(dee_bits));
+  put_fixed(&packed, dee_bits, 8);
+  put_fixed(&packed, tick, 8);
+  // like the text form, a single element is the entry text itself
+  size_t count = elements.size() > 1 ? elements.size() : 0;
+  put_varint(&packed, count);
+  for (size_t i = 0; i < count; ++i) {
+    put_varint(&packed, elements[i].length());
+    packed.append(elements[i]);
+  }
+  return packed;
+}
+
+static bool unpack_binary(const string& value, UserDbValue* v) {
+  if (value.length() < kBinaryValueHeaderSize ||
+      value[1] != kBinaryValueVersion) {
+    LOG(ERROR) << "unsupported userdb value format.";
+    return false;
+  }
+  const char* p = value.data() + 2;
+  v->commits = static_cast<int32_t>(get_fixed(p, 4));
+  uint64_t dee_bits = get_fixed(p + 4, 8);
+  std::memcpy(&v->dee, &dee_bits, sizeof(dee_bits));
+  v->dee = (std::min)(10000.0, v->dee);
+  v->tick = get_fixed(p + 12, 8);
+  size_t pos = kBinaryValueHeaderSize;
+  size_t count = 0;
+  if (pos < value.length() && !get_varint(value, &pos, &count)) {
+    LOG(ERROR) << "corrupt userdb value.";
+    return false;
+  }
+  v->elements.clear();
+  for (size_t i = 0; i < count; ++i) {
+    size_t length = 0;
+    if (!get_varint(value, &pos, &length) || length > value.length() - pos) {
+      LOG(ERROR) << "corrupt userdb value.";
+      return false;
+    }
+    v->elements.emplace_back(value, pos, length);
+    pos += length;
+  }
+  return true;
+}
+
 string UserDbValue::Pack() const {
   std::ostringstream packed;
   packed << "c=" << commits << " d=" << dee << " t=" << tick;
@@ -42,6 +140,8 @@ string UserDbValue::Pack() const {
 }
 
 bool UserDbValue::Unpack(const string& value) {
+  if (IsBinary(value))
+    return unpack_binary(value, this);
   vector<string> kv;
   boost::split(kv, value, boost::is_any_of(" "));
   for (const string& k_eq_v : kv) {
@@ -81,6 +181,16 @@ string UserDb::snapshot_extension() {
   return plain_userdb_extension;
 }
 
+static std::atomic<uint64_t> user_db_generation{0};
+
+uint64_t UserDb::generation() {
+  return user_db_generation.load();
+}
+
+void UserDb::NewGeneration() {
+  ++user_db_generation;
+}
+
 // key ::= code <space> <Tab> phrase
 
 static bool userdb_entry_parser(const Tsv& row, string* key, string* value) {
@@ -106,7 +216,9 @@ static bool userdb_entry_formatter(const string& key,
   boost::algorithm::split(row, key, boost::algorithm::is_any_of("\t"));
   if (row.size() != 2 || row[0].empty() || row[1].empty())
     return false;
-  row.push_back(value);
+  // snapshots are always in text
+  row.push_back(UserDbValue::IsBinary(value) ? UserDbValue(value).Pack()
+                                             : value);
   return true;
 }
 
@@ -156,9 +268,14 @@ bool UserDbHelper::UniformRestore(const path& snapshot_file) {
     LOG(ERROR) << ex.what();
     return false;
   }
+  UserDb::NewGeneration();
   return true;
 }
 
+string UserDbHelper::PackValue(const UserDbValue& value) {
+  return db_->binary_safe() ? value.PackBinary() : value.Pack();
+}
+
 bool UserDbHelper::IsUserDb() {
   string db_type;
   return db_->MetaFetch("/db_type", &db_type) && (db_type == "userdb");
@@ -241,7 +358,8 @@ bool UserDbMerger::Put(const string& key, const string& value) {
   o.dee = (std::max)(o.dee, v.dee);
   o.tick = max_tick_;
   o.elements = v.elements;
-  return db_->Update(key, o.Pack()) && ++merged_entries_;
+  return db_->Update(key, UserDbHelper(db_).PackValue(o)) &&
+         ++merged_entries_;
 }
 
 void UserDbMerger::CloseMerge() {
@@ -258,6 +376,7 @@ void UserDbMerger::CloseMerge() {
   LOG(INFO) << "total " << merged_entries_
             << " entries merged, tick = " << max_tick_;
   merged_entries_ = 0;
+  UserDb::NewGeneration();
 }
 
 UserDbImporter::UserDbImporter(Db* db) : db_(db) {}
@@ -282,7 +401,7 @@ bool UserDbImporter::Put(const string& key, const string& value) {
     o.commits = (std::min)(v.commits, -std::abs(o.commits));
   }
   o.elements = v.elements;
-  return db_->Update(key, o.Pack());
+  return db_->Update(key, UserDbHelper(db_).PackValue(o));
 }
 
 }  // namespace rime
@@ -29,8 +29,14 @@ struct UserDbValue {
 
   void AppendElements(const DictEntry& entry);
 
+  /// Text form "c=<commits> d=<dee> t=<tick> [e=<elements>]", used in
+  /// text files and snapshots.
   string Pack() const;
+  /// Compact binary form for dbs that are binary_safe().
+  string PackBinary() const;
+  /// Accepts either form.
   bool Unpack(const string& value);
+  static bool IsBinary(const string& value);
 };
 
 /**
@@ -44,6 +50,11 @@ class UserDb {
  public:
   static string snapshot_extension();
 
+  /// Counts the changes made to user dbs from outside user dictionaries,
+  /// such as restore and sync, which invalidate tick counts kept in memory.
+  RIME_API static uint64_t generation();
+  RIME_API static void NewGeneration();
+
   /// Abstract class for a user db component.
   class Component : public Db::Component {
    public:
@@ -69,6 +80,8 @@ class UserDbHelper {
   RIME_API static bool IsUniformFormat(const path& file_path);
   RIME_API bool UniformBackup(const path& snapshot_file);
   RIME_API bool UniformRestore(const path& snapshot_file);
+  /// Packs the value in the best form the db can store.
+  RIME_API string PackValue(const UserDbValue& value);
 
   bool IsUserDb();
   string GetDbName();
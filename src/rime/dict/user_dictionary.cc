@@ -6,6 +6,7 @@
 //
 #include <algorithm>
 #include <cfloat>
+#include <chrono>
 #include <cmath>
 #include <boost/algorithm/string.hpp>
 #include <boost/scope_exit.hpp>
@@ -18,6 +19,7 @@
 #include <rime/algo/syllabifier.h>
 #include <rime/algo/strings.h>
 #include <rime/dict/db.h>
+#include <rime/dict/db_index.h>
 #include <rime/dict/table.h>
 #include <rime/dict/user_dictionary.h>
 #include <rime/dict/vocabulary.h>
@@ -147,17 +149,294 @@ bool UserDictEntryIterator::Next() {
   return true;
 }
 
+// UserDbCache members
+
+UserDbCache::~UserDbCache() {
+  if (loaded()) {
+    CommitPendingTransaction();
+    Flush();
+  }
+}
+
+TickCount UserDbCache::tick() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  // the tick count in memory is up to date unless db has been restored or
+  // synced since
+  if (tick_generation_ != UserDb::generation()) {
+    FetchTickCount();
+    MergePendingUpdates();
+  }
+  return tick_;
+}
+
+void UserDbCache::UpdateTickCount(TickCount increment) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (pending_updates_.empty() && !tick_pending_)
+    pending_since_ = time(NULL);
+  tick_ += increment;
+  tick_pending_ = true;
+}
+
+bool UserDbCache::FetchTickCount() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  tick_generation_ = UserDb::generation();
+  string value;
+  try {
+    // an earlier version mistakenly wrote tick count into an empty key
+    if (!db_->MetaFetch("/tick", &value) && !db_->Fetch("", &value))
+      return false;
+    TickCount tick = std::stoul(value);
+    // the pending tick count is ahead of db
+    tick_ = tick_pending_ ? (std::max)(tick_, tick) : tick;
+    return true;
+  } catch (...) {
+    // tick_ = 0;
+    return false;
+  }
+}
+
+// the values pending were updated from the records before the merge; merge
+// them again with the merged records the way UserDbMerger does, lest they
+// be written over the merged ones.
+void UserDbCache::MergePendingUpdates() {
+  if (pending_updates_.empty() || !loaded())
+    return;
+  LOG(INFO) << "merging " << pending_updates_.size()
+            << " pending updates into synced user db '" << db_->name()
+            << "'.";
+  for (auto& update : pending_updates_) {
+    string value;
+    if (!db_->Fetch(update.first, &value))
+      continue;
+    UserDbValue ours(update.second);
+    UserDbValue theirs(value);
+    if (ours.tick < tick_) {
+      ours.dee = algo::formula_d(0, (double)tick_, ours.dee, (double)ours.tick);
+    }
+    if (theirs.tick < tick_) {
+      theirs.dee =
+          algo::formula_d(0, (double)tick_, theirs.dee, (double)theirs.tick);
+    }
+    if (std::abs(ours.commits) < std::abs(theirs.commits))
+      ours.commits = theirs.commits;
+    ours.dee = (std::max)(ours.dee, theirs.dee);
+    ours.tick = tick_;
+    if (ours.elements.empty())
+      ours.elements = theirs.elements;
+    update.second = UserDbHelper(db_).PackValue(ours);
+  }
+  // nor can the recent transaction be reverted to the values before the merge
+  transaction_undo_.clear();
+  in_transaction_ = false;
+}
+
+size_t UserDbCache::num_pending_updates() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  return pending_updates_.size();
+}
+
+map<string, string> UserDbCache::FetchPendingUpdates(
+    const string& prefix) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  map<string, string> updates;
+  for (auto it = pending_updates_.lower_bound(prefix);
+       it != pending_updates_.end() && boost::starts_with(it->first, prefix);
+       ++it) {
+    updates.emplace_hint(updates.end(), *it);
+  }
+  return updates;
+}
+
+bool UserDbCache::FetchPending(const string& key, string* value) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  auto found = pending_updates_.find(key);
+  if (found == pending_updates_.end())
+    return false;
+  *value = found->second;
+  return true;
+}
+
+void UserDbCache::Put(const string& key, const string& value) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (pending_updates_.empty() && !tick_pending_)
+    pending_since_ = time(NULL);
+  auto& pending_value = pending_updates_[key];
+  if (in_transaction_) {
+    // remember the value before the first update in the transaction
+    transaction_undo_.emplace(key, pending_value);
+  }
+  pending_value = value;
+}
+
+void UserDbCache::FlushIfDue() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (pending_updates_.empty() && !tick_pending_)
+    return;
+  if (pending_updates_.size() >= max_pending_updates_ ||
+      time(NULL) - pending_since_ >= kMaxPendingSeconds) {
+    Flush();
+  }
+}
+
+void UserDbCache::FlushIfIdle() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!in_transaction_)
+    FlushIfDue();
+  else if (time(NULL) - transaction_time_ > kMaxRevertSeconds)
+    CommitPendingTransaction();
+}
+
+bool UserDbCache::Flush() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (pending_updates_.empty() && !tick_pending_)
+    return true;
+  if (!loaded() || db_->readonly())
+    return false;
+  // merge with the records synced since the updates
+  tick();
+  DLOG(INFO) << "flushing " << pending_updates_.size()
+             << " updates to user db '" << db_->name() << "'.";
+  // another process may have counted further, eg. by syncing
+  string value;
+  if (db_->MetaFetch("/tick", &value)) {
+    try {
+      tick_ = (std::max)(tick_, (TickCount)std::stoul(value));
+    } catch (...) {
+    }
+  }
+  auto batch = As<Transactional>(db_);
+  // not to write to db while the index is being built from it
+  AdoptBuiltIndex(true);
+  if (batch)
+    batch->BeginTransaction();
+  bool ok = true;
+  for (const auto& update : pending_updates_) {
+    ok = db_->Update(update.first, update.second) && ok;
+    if (index_ && index_->loaded())
+      index_->Update(update.first, update.second);
+  }
+  try {
+    ok = db_->MetaUpdate("/tick", std::to_string(tick_)) && ok;
+  } catch (...) {
+    ok = false;
+  }
+  if (batch)
+    ok = batch->CommitTransaction() && ok;
+  if (!ok) {
+    LOG(ERROR) << "failed to write updates to user db '" << db_->name()
+               << "'.";
+  }
+  pending_updates_.clear();
+  tick_pending_ = false;
+  return ok;
+}
+
+// a transaction collects the updates made on a commit in memory, where
+// they can be reverted shortly after; they are written to db later in
+// batches of several transactions.
+
+bool UserDbCache::NewTransaction() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!loaded())
+    return false;
+  CommitPendingTransaction();
+  transaction_time_ = time(NULL);
+  transaction_tick_ = tick();
+  transaction_undo_.clear();
+  in_transaction_ = true;
+  return true;
+}
+
+bool UserDbCache::RevertRecentTransaction() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!in_transaction_)
+    return false;
+  if (time(NULL) - transaction_time_ > kMaxRevertSeconds)
+    return false;
+  for (const auto& undo : transaction_undo_) {
+    if (undo.second.empty())
+      pending_updates_.erase(undo.first);
+    else
+      pending_updates_[undo.first] = undo.second;
+  }
+  transaction_undo_.clear();
+  tick_ = transaction_tick_;
+  in_transaction_ = false;
+  return true;
+}
+
+bool UserDbCache::CommitPendingTransaction() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!in_transaction_)
+    return false;
+  transaction_undo_.clear();
+  in_transaction_ = false;
+  FlushIfDue();
+  return true;
+}
+
+an<DbIndex> UserDbCache::index() {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  if (!index_)
+    return nullptr;
+  AdoptBuiltIndex(false);
+  if (index_->generation() != UserDb::generation() && loaded()) {
+    // restored or synced
+    if (!index_build_.valid()) {
+      auto db = db_;
+      index_build_ = std::async(std::launch::async, [db] {
+        auto index = New<DbIndex>();
+        index->Build(db.get());
+        return index;
+      });
+    }
+    return nullptr;
+  }
+  return index_->loaded() ? index_ : nullptr;
+}
+
+void UserDbCache::AdoptBuiltIndex(bool wait) {
+  if (!index_build_.valid())
+    return;
+  if (!wait && index_build_.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready)
+    return;
+  try {
+    auto index = index_build_.get();
+    // invalidates the accessors of the index, as Build() does
+    if (index_ && index)
+      *index_ = std::move(*index);
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "error indexing user db '" << db_->name()
+               << "': " << ex.what();
+  }
+}
+
+bool UserDbCache::in_transaction() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  return in_transaction_;
+}
+
 // UserDictionary members
 
-UserDictionary::UserDictionary(const string& name, an<Db> db)
-    : name_(name), db_(db) {}
+UserDictionary::UserDictionary(const string& name,
+                               an<Db> db,
+                               an<UserDbCache> cache)
+    : name_(name), db_(db), cache_(cache ? cache : New<UserDbCache>(db)) {}
 
 UserDictionary::~UserDictionary() {
-  if (loaded()) {
-    CommitPendingTransaction();
+  // the last dictionary of the db leaves it to the cache to write back the
+  // recent transaction.
+  if (loaded() && !cache_->in_transaction()) {
+    FlushPendingUpdates();
   }
 }
 
+void UserDictionary::EnableIndex(const an<DbIndex>& index) {
+  index_ = index;
+  cache_->set_index(index);
+}
+
 void UserDictionary::Attach(const an<Table>& table, const an<Prism>& prism) {
   table_ = table;
   prism_ = prism;
@@ -176,7 +455,9 @@ bool UserDictionary::Load() {
     }
     return false;
   }
-  return FetchTickCount() || Initialize();
+  if (index_ && !index_->loaded())
+    index_->Build(db_.get());
+  return cache_->FetchTickCount() || Initialize();
 }
 
 bool UserDictionary::loaded() const {
@@ -217,31 +498,32 @@ void UserDictionary::DfsLookup(const SyllableGraph& syll_graph,
   if (current_pos == syll_graph.interpreted_length) {
     return;
   }
-  auto& index = syll_graph.indices[current_pos];
+  const auto& index = syll_graph.indices;
   DLOG(INFO) << "dfs lookup starts from " << current_pos;
   string prefix;
-  for (const auto& spelling : index) {
+  for (const auto& syllable : index.syllables(current_pos)) {
+    auto spellings = index.spellings(syllable);
     DLOG(INFO) << "prefix: '" << current_prefix << "'"
-               << ", syll_id: " << spelling.first
-               << ", num_spellings: " << spelling.second.size();
-    state->code.push_back(spelling.first);
+               << ", syll_id: " << syllable.syllable_id
+               << ", num_spellings: " << spellings.size();
+    state->code.push_back(syllable.syllable_id);
     BOOST_SCOPE_EXIT((&state)) {
       state->code.pop_back();
     }
     BOOST_SCOPE_EXIT_END
     if (!TranslateCodeToString(state->code, &prefix))
       continue;
-    for (size_t i = 0; i < spelling.second.size(); ++i) {
-      auto props = spelling.second[i];
-      if (i > 0 && props->type >= kAbbreviation)
+    for (size_t i = 0; i < spellings.size(); ++i) {
+      const auto& props = spellings[i];
+      if (i > 0 && props.type >= kAbbreviation)
         continue;
       state->credibility.push_back(state->credibility.back() +
-                                   props->credibility);
+                                   props.credibility);
       BOOST_SCOPE_EXIT((&state)) {
         state->credibility.pop_back();
       }
       BOOST_SCOPE_EXIT_END
-      size_t end_pos = props->end_pos;
+      size_t end_pos = props.end_pos;
       DLOG(INFO) << "edge: [" << current_pos << ", " << end_pos << ")";
       if (prefix != state->key) {  // 'a b c |d ' > 'a b c \tabracadabra'
         DLOG(INFO) << "forward scanning for '" << prefix << "'.";
@@ -311,10 +593,9 @@ an<UserDictEntryCollector> UserDictionary::Lookup(
   DfsState state;
   state.depth_limit = depth_limit;
   state.predict_word_from_depth = predict_word_from_depth;
-  FetchTickCount();
-  state.present_tick = tick_ + 1;
+  state.present_tick = cache_->tick() + 1;
   state.credibility.push_back(initial_credibility);
-  state.accessor = db_->Query("");
+  state.accessor = Query("");
   state.accessor->Jump(" ");  // skip metadata
   string prefix;
   DfsLookup(syll_graph, start_pos, prefix, &state);
@@ -332,7 +613,7 @@ size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
                                    bool predictive,
                                    size_t limit,
                                    string* resume_key) {
-  TickCount present_tick = tick_ + 1;
+  TickCount present_tick = cache_->tick() + 1;
   size_t len = input.length();
   size_t start = result->cache_size();
   size_t count = 0;
@@ -341,7 +622,7 @@ size_t UserDictionary::LookupWords(UserDictEntryIterator* result,
   string key;
   string value;
   string full_code;
-  auto accessor = db_->Query(input);
+  auto accessor = Query(input);
   if (!accessor || accessor->exhausted()) {
     if (resume_key)
       *resume_key = kEnd;
@@ -403,10 +684,11 @@ bool UserDictionary::UpdateEntry(const DictEntry& entry,
   string key(code_str + '\t' + entry.text);
   string value;
   UserDbValue v;
-  if (db_->Fetch(key, &value)) {
+  TickCount tick = cache_->tick();
+  if (Fetch(key, &value)) {
     v.Unpack(value);
-    if (v.tick > tick_) {
-      v.tick = tick_;  // fix abnormal timestamp
+    if (v.tick > tick) {
+      v.tick = tick;  // fix abnormal timestamp
     }
   } else if (!new_entry_prefix.empty()) {
     key.insert(0, new_entry_prefix);
@@ -416,71 +698,68 @@ bool UserDictionary::UpdateEntry(const DictEntry& entry,
       v.commits = -v.commits;  // revive a deleted item
     v.commits += commits;
     UpdateTickCount(1);
-    v.dee = algo::formula_d(commits, (double)tick_, v.dee, (double)v.tick);
+    tick = cache_->tick();
+    v.dee = algo::formula_d(commits, (double)tick, v.dee, (double)v.tick);
   } else if (commits == 0) {
     const double k = 0.1;
-    v.dee = algo::formula_d(k, (double)tick_, v.dee, (double)v.tick);
+    v.dee = algo::formula_d(k, (double)tick, v.dee, (double)v.tick);
   } else if (commits < 0) {  // mark as deleted
     v.commits = (std::min)(-1, -v.commits);
-    v.dee = algo::formula_d(0.0, (double)tick_, v.dee, (double)v.tick);
+    v.dee = algo::formula_d(0.0, (double)tick, v.dee, (double)v.tick);
   }
-  v.tick = tick_;
+  v.tick = tick;
   if (v.elements.empty())
     v.AppendElements(entry);
-  return db_->Update(key, v.Pack());
+  cache_->Put(key, UserDbHelper(db_).PackValue(v));
+  if (!cache_->in_transaction())
+    cache_->FlushIfDue();
+  return true;
 }
 
 bool UserDictionary::UpdateTickCount(TickCount increment) {
-  tick_ += increment;
-  try {
-    return db_->MetaUpdate("/tick", std::to_string(tick_));
-  } catch (...) {
-    return false;
-  }
+  cache_->UpdateTickCount(increment);
+  return true;
 }
 
-bool UserDictionary::Initialize() {
-  return db_->MetaUpdate("/tick", "0");
+an<DbAccessor> UserDictionary::Query(const string& prefix) {
+  auto index = cache_->index();
+  auto accessor = index ? index->Query(prefix) : db_->Query(prefix);
+  if (!accessor || !cache_->num_pending_updates())
+    return accessor;
+  // a copy, for the updates may be flushed by another thread meanwhile
+  auto pending_updates = cache_->FetchPendingUpdates(prefix);
+  if (pending_updates.empty())
+    return accessor;
+  return New<PendingUpdatesAccessor>(accessor, std::move(pending_updates),
+                                     prefix);
 }
 
-bool UserDictionary::FetchTickCount() {
-  string value;
-  try {
-    // an earlier version mistakenly wrote tick count into an empty key
-    if (!db_->MetaFetch("/tick", &value) && !db_->Fetch("", &value))
-      return false;
-    tick_ = std::stoul(value);
+bool UserDictionary::Fetch(const string& key, string* value) {
+  if (cache_->FetchPending(key, value))
     return true;
-  } catch (...) {
-    // tick_ = 0;
-    return false;
-  }
+  if (auto index = cache_->index())
+    return index->Fetch(key, value);
+  return db_->Fetch(key, value);
+}
+
+bool UserDictionary::FlushPendingUpdates() {
+  return cache_->Flush();
+}
+
+bool UserDictionary::Initialize() {
+  return db_->MetaUpdate("/tick", "0");
 }
 
 bool UserDictionary::NewTransaction() {
-  auto db = As<Transactional>(db_);
-  if (!db)
-    return false;
-  CommitPendingTransaction();
-  transaction_time_ = time(NULL);
-  return db->BeginTransaction();
+  return cache_->NewTransaction();
 }
 
 bool UserDictionary::RevertRecentTransaction() {
-  auto db = As<Transactional>(db_);
-  if (!db || !db->in_transaction())
-    return false;
-  if (time(NULL) - transaction_time_ > 3 /*seconds*/)
-    return false;
-  return db->AbortTransaction();
+  return cache_->RevertRecentTransaction();
 }
 
 bool UserDictionary::CommitPendingTransaction() {
-  auto db = As<Transactional>(db_);
-  if (db && db->in_transaction()) {
-    return db->CommitTransaction();
-  }
-  return false;
+  return cache_->CommitPendingTransaction();
 }
 
 bool UserDictionary::TranslateCodeToString(const Code& code, string* result) {
@@ -551,7 +830,35 @@ UserDictionary* UserDictionaryComponent::Create(const string& dict_name,
     db.reset(component->Create(dict_name));
     db_pool_[dict_name] = db;
   }
-  return new UserDictionary(dict_name, db);
+  // the dictionaries of the db see each other's updates held in memory
+  auto cache = cache_pool_[dict_name].lock();
+  if (!cache) {
+    cache = New<UserDbCache>(db);
+    cache_pool_[dict_name] = cache;
+  }
+  return new UserDictionary(dict_name, db, cache);
+}
+
+void UserDictionaryComponent::FlushPendingUpdates() {
+  for (auto it = cache_pool_.begin(); it != cache_pool_.end();) {
+    if (auto cache = it->second.lock()) {
+      cache->FlushIfIdle();
+      ++it;
+    } else {
+      it = cache_pool_.erase(it);
+    }
+  }
+}
+
+bool UserDictionaryComponent::FlushPendingUpdates(const string& dict_name) {
+  auto found = cache_pool_.find(dict_name);
+  if (found == cache_pool_.end())
+    return true;
+  auto cache = found->second.lock();
+  if (!cache)
+    return true;
+  cache->CommitPendingTransaction();
+  return cache->Flush();
 }
 
 UserDictionary* UserDictionaryComponent::Create(const Ticket& ticket) {
@@ -578,7 +885,25 @@ UserDictionary* UserDictionaryComponent::Create(const Ticket& ticket) {
     // user specified db class
   }
   // obtain userdb object
-  return Create(dict_name, db_class);
+  auto* user_dict = Create(dict_name, db_class);
+  bool enable_index = false;
+  if (user_dict &&
+      config->GetBool(ticket.name_space + "/user_dict_index", &enable_index) &&
+      enable_index) {
+    auto index = index_pool_[dict_name].lock();
+    if (!index) {
+      index = New<DbIndex>();
+      index_pool_[dict_name] = index;
+    }
+    user_dict->EnableIndex(index);
+  }
+  int max_pending_updates = 0;
+  if (user_dict &&
+      config->GetInt(ticket.name_space + "/user_dict_flush_threshold",
+                     &max_pending_updates)) {
+    user_dict->set_max_pending_updates((std::max)(0, max_pending_updates));
+  }
+  return user_dict;
 }
 
 }  // namespace rime
@@ -8,6 +8,8 @@
 #define RIME_USER_DICTIONARY_H_
 
 #include <time.h>
+#include <future>
+#include <mutex>
 #include <rime/common.h>
 #include <rime/component.h>
 #include <rime/dict/user_db.h>
@@ -38,6 +40,7 @@ class UserDictEntryIterator : public DictEntryFilterBinder {
 
 using UserDictEntryCollector = map<size_t, UserDictEntryIterator>;
 
+class DbIndex;
 class Schema;
 class Table;
 class Prism;
@@ -46,12 +49,92 @@ struct SyllableGraph;
 struct DfsState;
 struct Ticket;
 
+// the state of a user db held in memory: updates to write to db in a batch,
+// the transaction that can be reverted, and the tick count. shared by the
+// user dictionaries opened on the same db so that they see each other's
+// updates. the sessions and the sync task on the deployer's thread access it
+// under a lock.
+class UserDbCache {
+ public:
+  // updates held in memory before they are written to db in a batch.
+  static const size_t kDefaultMaxPendingUpdates = 32;
+  // flush older updates at the end of the next transaction.
+  static const time_t kMaxPendingSeconds = 60;
+  // the recent transaction can be reverted within this time.
+  static const time_t kMaxRevertSeconds = 3;
+
+  explicit UserDbCache(an<Db> db) : db_(db) {}
+  ~UserDbCache();
+
+  // re-reads the tick count if db has been restored or synced since, and
+  // merges the pending updates into the records in db.
+  TickCount tick();
+  void UpdateTickCount(TickCount increment);
+  bool FetchTickCount();
+
+  size_t num_pending_updates() const;
+  // a copy of the pending updates of keys with the prefix.
+  map<string, string> FetchPendingUpdates(const string& prefix) const;
+  bool FetchPending(const string& key, string* value) const;
+  void Put(const string& key, const string& value);
+  // writes the pending updates to db if there are enough of them or they have
+  // been held for long.
+  void FlushIfDue();
+  // also commits the recent transaction once it can no longer be reverted.
+  void FlushIfIdle();
+  bool Flush();
+
+  bool NewTransaction();
+  bool RevertRecentTransaction();
+  bool CommitPendingTransaction();
+  bool in_transaction() const;
+
+  // the index to keep in sync with the updates written to db.
+  void set_index(const an<DbIndex>& index) { index_ = index; }
+  // the index if it is up to date. once db has been restored or synced, it
+  // is rebuilt in the background while lookups read from db.
+  an<DbIndex> index();
+  // 0 to write updates to db at the end of each transaction.
+  void set_max_pending_updates(size_t max_pending_updates) {
+    max_pending_updates_ = max_pending_updates;
+  }
+
+ private:
+  bool loaded() const { return db_ && !db_->disabled() && db_->loaded(); }
+  void MergePendingUpdates();
+  void AdoptBuiltIndex(bool wait);
+
+  mutable std::recursive_mutex mutex_;
+  an<Db> db_;
+  an<DbIndex> index_;
+  std::future<an<DbIndex>> index_build_;
+  TickCount tick_ = 0;
+  // of user dbs when tick_ was last fetched from db
+  uint64_t tick_generation_ = 0;
+  time_t transaction_time_ = 0;
+  bool in_transaction_ = false;
+  // to revert the recent transaction: tick count at the beginning, and
+  // pending values of the keys updated, empty if there was none.
+  TickCount transaction_tick_ = 0;
+  map<string, string> transaction_undo_;
+  // updates to write to db, by key
+  map<string, string> pending_updates_;
+  bool tick_pending_ = false;
+  time_t pending_since_ = 0;
+  size_t max_pending_updates_ = kDefaultMaxPendingUpdates;
+};
+
 class UserDictionary : public Class<UserDictionary, const Ticket&> {
  public:
-  UserDictionary(const string& name, an<Db> db);
+  // cache is shared by the dictionaries of the db; a private one if null.
+  UserDictionary(const string& name,
+                 an<Db> db,
+                 an<UserDbCache> cache = nullptr);
   virtual ~UserDictionary();
 
   void Attach(const an<Table>& table, const an<Prism>& prism);
+  // reads from a copy of db in memory, shared by dictionaries of the db.
+  void EnableIndex(const an<DbIndex>& index);
   bool Load();
   bool loaded() const;
   bool readonly() const;
@@ -75,9 +158,16 @@ class UserDictionary : public Class<UserDictionary, const Ticket&> {
   bool NewTransaction();
   bool RevertRecentTransaction();
   bool CommitPendingTransaction();
+  // writes the pending updates to db.
+  bool FlushPendingUpdates();
 
   const string& name() const { return name_; }
-  TickCount tick() const { return tick_; }
+  TickCount tick() const { return cache_->tick(); }
+  size_t pending_updates() const { return cache_->num_pending_updates(); }
+  // 0 to write updates to db at the end of each transaction.
+  void set_max_pending_updates(size_t max_pending_updates) {
+    cache_->set_max_pending_updates(max_pending_updates);
+  }
 
   static an<DictEntry> CreateDictEntry(const string& key,
                                        const string& value,
@@ -87,8 +177,10 @@ class UserDictionary : public Class<UserDictionary, const Ticket&> {
 
  protected:
   bool Initialize();
-  bool FetchTickCount();
   bool TranslateCodeToString(const Code& code, string* result);
+  // db access seeing the pending updates.
+  an<DbAccessor> Query(const string& prefix);
+  bool Fetch(const string& key, string* value);
   void DfsLookup(const SyllableGraph& syll_graph,
                  size_t current_pos,
                  const string& current_prefix,
@@ -97,11 +189,11 @@ class UserDictionary : public Class<UserDictionary, const Ticket&> {
  private:
   string name_;
   an<Db> db_;
+  an<UserDbCache> cache_;
+  an<DbIndex> index_;
   an<Table> table_;
   an<Prism> prism_;
   map<string, SyllableId> syllabary_;
-  TickCount tick_ = 0;
-  time_t transaction_time_ = 0;
 };
 
 class UserDictionaryComponent : public UserDictionary::Component {
@@ -109,9 +201,16 @@ class UserDictionaryComponent : public UserDictionary::Component {
   UserDictionaryComponent();
   UserDictionary* Create(const Ticket& ticket);
   UserDictionary* Create(const string& dict_name, const string& db_class);
+  // writes back the updates held in memory for long, when the user is idle.
+  void FlushPendingUpdates();
+  // writes back all updates held in memory for the db, eg. before it is
+  // backed up or synced.
+  bool FlushPendingUpdates(const string& dict_name);
 
  private:
   map<string, weak<Db>> db_pool_;
+  map<string, weak<UserDbCache>> cache_pool_;
+  map<string, weak<DbIndex>> index_pool_;
 };
 
 }  // namespace rime
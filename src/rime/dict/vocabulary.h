@@ -100,6 +100,9 @@ class Vocabulary : public map<int, VocabularyPage> {
 // word -> { code, ... }
 using ReverseLookupTable = hash_map<string, set<string>>;
 
+// name and checksum of each source file of a table
+using TableSources = vector<pair<string, uint32_t>>;
+
 }  // namespace rime
 
 #endif  // RIME_VOCABULARY_H_
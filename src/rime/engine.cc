@@ -73,7 +73,7 @@ ConcreteEngine::ConcreteEngine() {
   // receive context notifications
   context_->commit_notifier().connect([this](Context* ctx) { OnCommit(ctx); });
   context_->select_notifier().connect([this](Context* ctx) { OnSelect(ctx); });
-  context_->update_notifier().connect(
+  context_->compose_notifier().connect(
       [this](Context* ctx) { OnContextUpdate(ctx); });
   context_->option_update_notifier().connect(
       [this](Context* ctx, const string& option) {
@@ -131,6 +131,9 @@ void ConcreteEngine::OnOptionUpdate(Context* ctx, const string& option) {
   if (!ctx)
     return;
   LOG(INFO) << "updated option: " << option;
+  if (option == "lazy_composition") {
+    ctx->set_lazy_composition(ctx->get_option(option));
+  }
   // apply new option to active segment
   if (ctx->IsComposing()) {
     ctx->RefreshNonConfirmedComposition();
@@ -0,0 +1,75 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <rime/gear/grammar_cache.h>
+
+namespace rime {
+
+CachedGrammar::CachedGrammar(Grammar* grammar, size_t capacity)
+    : grammar_(grammar), capacity_(capacity) {}
+
+double CachedGrammar::Query(const string& context,
+                            const string& word,
+                            bool is_rear) {
+  MakeKey(context, std::string_view(), word, is_rear);
+  if (const double* value = Find())
+    return *value;
+  return Remember(grammar_->Query(context, word, is_rear));
+}
+
+double CachedGrammar::QueryInContext(const GrammarContext& context,
+                                     const string& word,
+                                     bool is_rear) {
+  MakeKey(context.first, context.second, word, is_rear);
+  if (const double* value = Find())
+    return *value;
+  context_.assign(context.first.data(), context.first.size());
+  context_.append(context.second.data(), context.second.size());
+  return Remember(grammar_->Query(context_, word, is_rear));
+}
+
+void CachedGrammar::Clear() {
+  index_.clear();
+  entries_.clear();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+void CachedGrammar::MakeKey(std::string_view context_first,
+                            std::string_view context_second,
+                            const string& word,
+                            bool is_rear) {
+  // texts do not contain NUL characters
+  key_.assign(context_first.data(), context_first.size());
+  key_.append(context_second.data(), context_second.size());
+  key_.push_back('\0');
+  key_.append(word);
+  key_.push_back(is_rear ? '$' : '\0');
+}
+
+const double* CachedGrammar::Find() {
+  auto found = index_.find(key_);
+  if (found == index_.end()) {
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  // move to front
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return &found->second->value;
+}
+
+double CachedGrammar::Remember(double value) {
+  if (capacity_ == 0)
+    return value;
+  if (entries_.size() >= capacity_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  entries_.push_front({key_, value});
+  index_.emplace(entries_.front().key, entries_.begin());
+  return value;
+}
+
+}  // namespace rime
@@ -0,0 +1,77 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_GRAMMAR_CACHE_H_
+#define RIME_GRAMMAR_CACHE_H_
+
+#include <list>
+#include <string_view>
+#include <rime/common.h>
+#include <rime/gear/grammar.h>
+
+namespace rime {
+
+// text preceding a word, in two parts that read as one string.
+struct GrammarContext {
+  std::string_view first;
+  std::string_view second;
+};
+
+// memoizes the results of a grammar, keeping those most recently used.
+class CachedGrammar : public Grammar {
+ public:
+  static const size_t kDefaultCapacity = 4096;
+
+  CachedGrammar(Grammar* grammar, size_t capacity = kDefaultCapacity);
+
+  double Query(const string& context,
+               const string& word,
+               bool is_rear) override;
+  // looks up the context given in parts, which are joined only to query
+  // the grammar on a miss.
+  double QueryInContext(const GrammarContext& context,
+                        const string& word,
+                        bool is_rear);
+
+  void Clear();
+
+  size_t capacity() const { return capacity_; }
+  size_t size() const { return entries_.size(); }
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+  double hit_rate() const {
+    size_t total = hits_ + misses_;
+    return total ? double(hits_) / total : 0.0;
+  }
+
+ private:
+  struct Entry {
+    string key;
+    double value;
+  };
+  using EntryList = std::list<Entry>;
+
+  void MakeKey(std::string_view context_first,
+               std::string_view context_second,
+               const string& word,
+               bool is_rear);
+  // returns nullptr if the key_ buffer is not cached.
+  const double* Find();
+  double Remember(double value);
+
+  the<Grammar> grammar_;
+  size_t capacity_;
+  // most recently used first
+  EntryList entries_;
+  // keys are views of the strings owned by entries_
+  hash_map<std::string_view, EntryList::iterator> index_;
+  string key_;
+  string context_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+}  // namespace rime
+
+#endif  // RIME_GRAMMAR_CACHE_H_
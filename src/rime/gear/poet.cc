@@ -7,11 +7,14 @@
 // 2011-10-06 GONG Chen <chen.sst@gmail.com>
 //
 #include <algorithm>
+#include <deque>
 #include <functional>
+#include <string_view>
 #include <rime/candidate.h>
 #include <rime/config.h>
 #include <rime/dict/vocabulary.h>
 #include <rime/gear/grammar.h>
+#include <rime/gear/grammar_cache.h>
 #include <rime/gear/poet.h>
 
 namespace rime {
@@ -19,19 +22,23 @@ namespace rime {
 // internal data structure used during the sentence making process.
 // the output line of the algorithm is transformed to an<Sentence>.
 struct Line {
-  // be sure the pointer to predecessor Line object is stable. it works since
-  // pointer to values stored in std::map and std::unordered_map are stable.
+  // lines are allocated in a LineArena, where pointers to them are stable.
   const Line* predecessor;
   // as long as the word graph lives, pointers to entries are valid.
   const DictEntry* entry;
   size_t end_pos;
   double weight;
+  // interned text of the entry, or kNoWord for the empty line.
+  int word_id;
 
+  static constexpr int kNoWord = -1;
   static const Line kEmpty;
 
   bool empty() const { return !predecessor && !entry; }
 
-  string last_word() const { return entry ? entry->text : string(); }
+  std::string_view last_word() const {
+    return entry ? std::string_view(entry->text) : std::string_view();
+  }
 
   struct Components {
     vector<const Line*> lines;
@@ -49,12 +56,10 @@ struct Line {
 
   Components components() const { return Components(this); }
 
-  string context() const {
+  GrammarContext context() const {
     // look back 2 words
-    return empty() ? string()
-           : !predecessor || predecessor->empty()
-               ? last_word()
-               : predecessor->last_word() + last_word();
+    return {predecessor ? predecessor->last_word() : std::string_view(),
+            last_word()};
   }
 
   vector<size_t> word_lengths() const {
@@ -68,7 +73,45 @@ struct Line {
   }
 };
 
-const Line Line::kEmpty{nullptr, nullptr, 0, 0.0};
+const Line Line::kEmpty{nullptr, nullptr, 0, 0.0, Line::kNoWord};
+
+// lines are only ever added during a sentence making pass and released
+// all together at the end of it.
+using LineArena = std::deque<Line>;
+
+// an edge of the word graph, flattened for the sentence making pass.
+struct WordEdge {
+  size_t end_pos;
+  const DictEntry* entry;
+  int word_id;
+};
+
+// the word graph in arrays indexed by start position, with texts of words
+// interned to integer ids.
+using FlatWordGraph = vector<vector<WordEdge>>;
+
+static FlatWordGraph flatten_word_graph(const WordGraph& graph,
+                                        size_t total_length) {
+  FlatWordGraph flat(total_length + 1);
+  hash_map<std::string_view, int> word_ids;
+  for (const auto& sv : graph) {
+    if (sv.first < 0 || static_cast<size_t>(sv.first) > total_length)
+      continue;
+    auto& edges = flat[sv.first];
+    for (const auto& ev : sv.second) {
+      if (ev.first < 0 || static_cast<size_t>(ev.first) > total_length)
+        continue;
+      for (const auto& entry : ev.second) {
+        int word_id = word_ids
+                          .emplace(std::string_view(entry->text),
+                                   static_cast<int>(word_ids.size()))
+                          .first->second;
+        edges.push_back({static_cast<size_t>(ev.first), entry.get(), word_id});
+      }
+    }
+  }
+  return flat;
+}
 
 inline static Grammar* create_grammar(Config* config) {
   if (auto* grammar = Grammar::Require("grammar")) {
@@ -80,10 +123,35 @@ inline static Grammar* create_grammar(Config* config) {
 Poet::Poet(const Language* language, Config* config, Compare compare)
     : language_(language),
       grammar_(create_grammar(config)),
-      compare_(compare) {}
+      compare_(compare) {
+  if (!grammar_)
+    return;
+  int cache_size = CachedGrammar::kDefaultCapacity;
+  if (config) {
+    config->GetInt("grammar/cache_size", &cache_size);
+  }
+  if (cache_size > 0) {
+    grammar_cache_ = new CachedGrammar(grammar_.release(), cache_size);
+    grammar_.reset(grammar_cache_);
+  }
+}
 
 Poet::~Poet() {}
 
+double Poet::Evaluate(const GrammarContext& context,
+                      const DictEntry& entry,
+                      bool is_rear) {
+  if (grammar_cache_) {
+    return entry.weight +
+           grammar_cache_->QueryInContext(context, entry.text, is_rear);
+  }
+  if (grammar_) {
+    context_buffer_.assign(context.first.data(), context.first.size());
+    context_buffer_.append(context.second.data(), context.second.size());
+  }
+  return Grammar::Evaluate(context_buffer_, entry, is_rear, grammar_.get());
+}
+
 bool Poet::CompareWeight(const Line& one, const Line& other) {
   return one.weight < other.weight;
 }
@@ -108,7 +176,7 @@ bool Poet::LeftAssociateCompare(const Line& one, const Line& other) {
 }
 
 // keep the best line candidate per last phrase
-using LineCandidates = hash_map<string, Line>;
+using LineCandidates = hash_map<int, const Line*>;
 
 template <int N>
 static vector<const Line*> find_top_candidates(const LineCandidates& candidates,
@@ -117,11 +185,11 @@ static vector<const Line*> find_top_candidates(const LineCandidates& candidates,
   top.reserve(N + 1);
   for (const auto& candidate : candidates) {
     auto pos = std::upper_bound(
-        top.begin(), top.end(), &candidate.second,
+        top.begin(), top.end(), candidate.second,
         [&](const Line* a, const Line* b) { return compare(*b, *a); });  // desc
     if (pos - top.begin() >= N)
       continue;
-    top.insert(pos, &candidate.second);
+    top.insert(pos, candidate.second);
     if (top.size() > N)
       top.pop_back();
   }
@@ -136,9 +204,11 @@ struct BeamSearch {
   static constexpr int kMaxLineCandidates = 7;
 
   static void Initiate(State& initial_state) {
-    initial_state.emplace("", Line::kEmpty);
+    initial_state.emplace(Line::kNoWord, &Line::kEmpty);
   }
 
+  static bool IsReached(const State& state) { return !state.empty(); }
+
   static void ForEachCandidate(const State& state,
                                Poet::Compare compare,
                                UpdateLineCandidate update) {
@@ -149,39 +219,40 @@ struct BeamSearch {
     }
   }
 
-  static Line& BestLineToUpdate(State& state, const Line& new_line) {
-    const auto& key = new_line.last_word();
-    return state[key];
+  static const Line*& BestLineToUpdate(State& state, const Line& new_line) {
+    return state[new_line.word_id];
   }
 
-  static const Line& BestLineInState(const State& final_state,
+  static const Line* BestLineInState(const State& final_state,
                                      Poet::Compare compare) {
     const Line* best = nullptr;
     for (const auto& candidate : final_state) {
-      if (!best || compare(*best, candidate.second)) {
-        best = &candidate.second;
+      if (!best || compare(*best, *candidate.second)) {
+        best = candidate.second;
       }
     }
-    return best ? *best : Line::kEmpty;
+    return best;
   }
 };
 
 struct DynamicProgramming {
-  using State = Line;
+  using State = const Line*;
+
+  static void Initiate(State& initial_state) { initial_state = &Line::kEmpty; }
 
-  static void Initiate(State& initial_state) { initial_state = Line::kEmpty; }
+  static bool IsReached(const State& state) { return state != nullptr; }
 
   static void ForEachCandidate(const State& state,
                                Poet::Compare compare,
                                UpdateLineCandidate update) {
-    update(state);
+    update(*state);
   }
 
-  static Line& BestLineToUpdate(State& state, const Line& new_line) {
+  static const Line*& BestLineToUpdate(State& state, const Line& new_line) {
     return state;
   }
 
-  static const Line& BestLineInState(const State& final_state,
+  static const Line* BestLineInState(const State& final_state,
                                      Poet::Compare compare) {
     return final_state;
   }
@@ -191,50 +262,51 @@ template <class Strategy>
 an<Sentence> Poet::MakeSentenceWithStrategy(const WordGraph& graph,
                                             size_t total_length,
                                             const string& preceding_text) {
-  map<int, typename Strategy::State> states;
+  const FlatWordGraph flat_graph = flatten_word_graph(graph, total_length);
+  const GrammarContext initial_context{std::string_view(), preceding_text};
+  LineArena arena;
+  vector<typename Strategy::State> states(total_length + 1);
   Strategy::Initiate(states[0]);
-  for (const auto& sv : graph) {
-    size_t start_pos = sv.first;
-    if (states.find(start_pos) == states.end())
+  for (size_t start_pos = 0; start_pos < total_length; ++start_pos) {
+    const auto& edges = flat_graph[start_pos];
+    if (edges.empty() || !Strategy::IsReached(states[start_pos]))
       continue;
     DLOG(INFO) << "start pos: " << start_pos;
     const auto& source_state = states[start_pos];
-    const auto update = [this, &states, &sv, start_pos, total_length,
-                         &preceding_text](const Line& candidate) {
-      for (const auto& ev : sv.second) {
-        size_t end_pos = ev.first;
+    const auto update = [this, &states, &arena, &edges, &initial_context,
+                         start_pos, total_length](const Line& candidate) {
+      const GrammarContext context =
+          candidate.empty() ? initial_context : candidate.context();
+      // extend candidates with dict entries on valid edges.
+      for (const auto& edge : edges) {
+        size_t end_pos = edge.end_pos;
         if (start_pos == 0 && end_pos == total_length)
           continue;  // exclude single word from the result
-        DLOG(INFO) << "end pos: " << end_pos;
         bool is_rear = end_pos == total_length;
-        auto& target_state = states[end_pos];
-        // extend candidates with dict entries on a valid edge.
-        const DictEntryList& entries = ev.second;
-        for (const auto& entry : entries) {
-          const string& context =
-              candidate.empty() ? preceding_text : candidate.context();
-          double weight =
-              candidate.weight +
-              Grammar::Evaluate(context, *entry.get(), is_rear, grammar_.get());
-          Line new_line{&candidate, entry.get(), end_pos, weight};
-          Line& best = Strategy::BestLineToUpdate(target_state, new_line);
-          if (best.empty() || compare_(best, new_line)) {
-            DLOG(INFO) << "updated line ending at " << end_pos
-                       << " with text: ..." << new_line.last_word()
-                       << " weight: " << new_line.weight;
-            best = new_line;
-          }
+        double weight =
+            candidate.weight + Evaluate(context, *edge.entry, is_rear);
+        Line new_line{&candidate, edge.entry, end_pos, weight, edge.word_id};
+        const Line*& best =
+            Strategy::BestLineToUpdate(states[end_pos], new_line);
+        if (!best || best->empty() || compare_(*best, new_line)) {
+          DLOG(INFO) << "updated line ending at " << end_pos
+                     << " with text: ..." << new_line.last_word()
+                     << " weight: " << new_line.weight;
+          arena.push_back(new_line);
+          best = &arena.back();
         }
       }
     };
     Strategy::ForEachCandidate(source_state, compare_, update);
   }
-  auto found = states.find(total_length);
-  if (found == states.end() || found->second.empty())
+  const auto& final_state = states[total_length];
+  if (!Strategy::IsReached(final_state))
+    return nullptr;
+  const Line* best = Strategy::BestLineInState(final_state, compare_);
+  if (!best || best->empty())
     return nullptr;
-  const Line& best = Strategy::BestLineInState(found->second, compare_);
   auto sentence = New<Sentence>(language_);
-  for (const auto* c : best.components()) {
+  for (const auto* c : best->components()) {
     if (!c->entry)
       continue;
     sentence->Extend(*c->entry, c->end_pos, c->weight);
@@ -245,10 +317,18 @@ an<Sentence> Poet::MakeSentenceWithStrategy(const WordGraph& graph,
 an<Sentence> Poet::MakeSentence(const WordGraph& graph,
                                 size_t total_length,
                                 const string& preceding_text) {
-  return grammar_ ? MakeSentenceWithStrategy<BeamSearch>(graph, total_length,
-                                                         preceding_text)
-                  : MakeSentenceWithStrategy<DynamicProgramming>(
-                        graph, total_length, preceding_text);
+  if (!grammar_) {
+    return MakeSentenceWithStrategy<DynamicProgramming>(graph, total_length,
+                                                        preceding_text);
+  }
+  auto sentence =
+      MakeSentenceWithStrategy<BeamSearch>(graph, total_length, preceding_text);
+  if (grammar_cache_) {
+    DLOG(INFO) << "grammar cache: " << grammar_cache_->size() << " entries, "
+               << grammar_cache_->hits() << " hits, "
+               << grammar_cache_->misses() << " misses.";
+  }
+  return sentence;
 }
 
 }  // namespace rime
@@ -19,8 +19,10 @@ namespace rime {
 
 using WordGraph = map<int, map<int, DictEntryList>>;
 
+class CachedGrammar;
 class Grammar;
 class Language;
+struct GrammarContext;
 struct Line;
 
 class Poet {
@@ -40,6 +42,10 @@ class Poet {
                             size_t total_length,
                             const string& preceding_text);
 
+  // grammar query results remembered for this session, with hit counters;
+  // null if there is no grammar or the cache is disabled.
+  const CachedGrammar* grammar_cache() const { return grammar_cache_; }
+
   template <class TranslatorT>
   an<Translation> ContextualWeighted(an<Translation> translation,
                                      const string& input,
@@ -61,10 +67,16 @@ class Poet {
   an<Sentence> MakeSentenceWithStrategy(const WordGraph& graph,
                                         size_t total_length,
                                         const string& preceding_text);
+  double Evaluate(const GrammarContext& context,
+                  const DictEntry& entry,
+                  bool is_rear);
 
   const Language* language_;
   the<Grammar> grammar_;
+  CachedGrammar* grammar_cache_ = nullptr;
   Compare compare_;
+  // joins the parts of context for grammars without a cache
+  string context_buffer_;
 };
 
 }  // namespace rime
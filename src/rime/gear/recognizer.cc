@@ -69,6 +69,16 @@ RecognizerMatch RecognizerPatterns::GetMatch(
   return RecognizerMatch();
 }
 
+bool RecognizerPatterns::MatchesToEnd(const string& active_input) const {
+  for (const auto& v : *this) {
+    boost::smatch m;
+    if (boost::regex_search(active_input, m, v.second) &&
+        size_t(m.position() + m.length()) == active_input.length())
+      return true;
+  }
+  return false;
+}
+
 Recognizer::Recognizer(const Ticket& ticket) : Processor(ticket) {
   if (!ticket.schema)
     return;
@@ -89,6 +99,10 @@ ProcessResult Recognizer::ProcessKeyEvent(const KeyEvent& key_event) {
     Context* ctx = engine_->context();
     string input = ctx->input();
     input += ch;
+    // with no segment selected, the whole input is active; spare composing
+    // the input on each key if no pattern can match.
+    if (!ctx->HasSelectedSegment() && !patterns_.MatchesToEnd(input))
+      return kNoop;
     auto match = patterns_.GetMatch(input, ctx->composition());
     if (match.found()) {
       ctx->PushInput(ch);
@@ -32,6 +32,9 @@ class RecognizerPatterns : public map<string, boost::regex> {
   void LoadConfig(Config* config);
   RecognizerMatch GetMatch(const string& input,
                            const Segmentation& segmentation) const;
+  // whether a pattern matches the active input up to its end, which is
+  // necessary for GetMatch() to find a match.
+  bool MatchesToEnd(const string& active_input) const;
 };
 
 class Recognizer : public Processor {
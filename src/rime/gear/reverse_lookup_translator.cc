@@ -173,7 +173,8 @@ an<Translation> ReverseLookupTranslator::Query(const string& input,
   if (start < input.length()) {
     if (options_ && options_->enable_completion()) {
       dict_->LookupWords(&iter, code, true, 100);
-      quality = !iter.exhausted() && (iter.Peek()->remaining_code_length == 0);
+      quality = !iter.exhausted() &&
+                (iter.PeekView().remaining_code_length == 0);
     } else {
       // 2012-04-08 gongchen: fetch multi-syllable words from rev-lookup table
       SyllableGraph graph;
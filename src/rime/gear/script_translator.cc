@@ -10,7 +10,7 @@
 #include <stack>
 #include <cmath>
 #include <boost/algorithm/string/join.hpp>
-#include <boost/range/adaptor/reversed.hpp>
+#include <boost/scope_exit.hpp>
 #include <rime/composition.h>
 #include <rime/candidate.h>
 #include <rime/config.h>
@@ -18,6 +18,7 @@
 #include <rime/engine.h>
 #include <rime/schema.h>
 #include <rime/translation.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/syllabifier.h>
 #include <rime/dict/corrector.h>
 #include <rime/dict/dictionary.h>
@@ -42,7 +43,7 @@ struct SyllabifyTask {
   function<void(SyllabifyTask* task,
                 size_t depth,
                 size_t current_pos,
-                size_t next_pos)>
+                const IndexedSpelling& edge)>
       push;
   function<void(SyllabifyTask* task, size_t depth)> pop;
 };
@@ -54,21 +55,19 @@ static bool syllabify_dfs(SyllabifyTask* task,
     return current_pos == task->target_pos;
   }
   SyllableId syllable_id = task->code.at(depth);
-  auto z = task->graph.edges.find(current_pos);
-  if (z == task->graph.edges.end())
+  const auto& index = task->graph.indices;
+  const auto* syllable = index.Find(current_pos, syllable_id);
+  if (!syllable)
     return false;
   // favor longer spellings
-  for (const auto& y : boost::adaptors::reverse(z->second)) {
-    size_t end_vertex_pos = y.first;
+  for (const auto& edge : index.spellings(*syllable)) {
+    size_t end_vertex_pos = edge.end_pos;
     if (end_vertex_pos > task->target_pos)
       continue;
-    auto x = y.second.find(syllable_id);
-    if (x != y.second.end()) {
-      task->push(task, depth, current_pos, end_vertex_pos);
-      if (syllabify_dfs(task, depth + 1, end_vertex_pos))
-        return true;
-      task->pop(task, depth);
-    }
+    task->push(task, depth, current_pos, edge);
+    if (syllabify_dfs(task, depth + 1, end_vertex_pos))
+      return true;
+    task->pop(task, depth);
   }
   return false;
 }
@@ -145,6 +144,7 @@ ScriptTranslator::ScriptTranslator(const Ticket& ticket)
                     &encode_commit_history_);
     config->GetBool(name_space_ + "/combine_candidates", &combine_candidates_);
     config->GetInt(name_space_ + "/max_homophones", &max_homophones_);
+    config->GetBool(name_space_ + "/parallel_lookup", &parallel_lookup_);
     poet_.reset(new Poet(language(), config));
   }
   if (enable_correction_) {
@@ -237,7 +237,9 @@ Spans ScriptSyllabifier::Syllabify(const Phrase* phrase) {
   SyllabifyTask task{
       phrase->code(), syllable_graph_, phrase->end() - start_,
       [&](SyllabifyTask* task, size_t depth, size_t current_pos,
-          size_t next_pos) { vertices.push_back(start_ + next_pos); },
+          const IndexedSpelling& edge) {
+        vertices.push_back(start_ + edge.end_pos);
+      },
       [&](SyllabifyTask* task, size_t depth) { vertices.pop_back(); }};
   if (syllabify_dfs(&task, 0, phrase->start() - start_)) {
     result.set_vertices(std::move(vertices));
@@ -256,25 +258,9 @@ bool ScriptSyllabifier::IsCandidateCorrection(const rime::Phrase& cand) const {
   // correction or completion
   SyllabifyTask task{cand.code(), syllable_graph_, cand.end() - start_,
                      [&](SyllabifyTask* task, size_t depth, size_t current_pos,
-                         size_t next_pos) {
-                       auto id = cand.code()[depth];
-                       auto it_s = syllable_graph_.edges.find(current_pos);
-                       // C++ prohibit operator [] of const map
-                       // if
-                       // (syllable_graph_.edges[current_pos][next_pos][id].type
-                       // == kCorrection)
-                       if (it_s != syllable_graph_.edges.end()) {
-                         auto it_e = it_s->second.find(next_pos);
-                         if (it_e != it_s->second.end()) {
-                           auto it_type = it_e->second.find(id);
-                           if (it_type != it_e->second.end()) {
-                             results.push(it_type->second.is_correction ||
-                                          it_type->second.type == kCompletion);
-                             return;
-                           }
-                         }
-                       }
-                       results.push(false);
+                         const IndexedSpelling& edge) {
+                       results.push(edge.is_correction ||
+                                    edge.type == kCompletion);
                      },
                      [&](SyllabifyTask* task, size_t depth) { results.pop(); }};
   if (syllabify_dfs(&task, 0, cand.start() - start_)) {
@@ -292,14 +278,14 @@ string ScriptSyllabifier::GetPreeditString(const Phrase& cand) const {
   string output;
   SyllabifyTask task{cand.matching_code(), syllable_graph_, cand.end() - start_,
                      [&](SyllabifyTask* task, size_t depth, size_t current_pos,
-                         size_t next_pos) {
+                         const IndexedSpelling& edge) {
                        size_t len = output.length();
                        if (depth > 0 && len > 0 &&
                            delimiters.find(output[len - 1]) == string::npos) {
                          output += delimiters.at(0);
                        }
                        output +=
-                           input_.substr(current_pos, next_pos - current_pos);
+                           input_.substr(current_pos, edge.end_pos - current_pos);
                        lengths.push(len);
                      },
                      [&](SyllabifyTask* task, size_t depth) {
@@ -327,6 +313,11 @@ static bool is_exact_match_phrase(const an<DictEntry>& entry) {
                    entry->matching_code_size == entry->code.size());
 }
 
+static bool is_exact_match_phrase(const DictEntryView& entry) {
+  return entry && (entry.matching_code_size == 0 ||
+                   entry.matching_code_size == entry.code->size());
+}
+
 // ScriptTranslation implementation
 
 bool ScriptTranslation::Evaluate(Dictionary* dict, UserDictionary* user_dict) {
@@ -374,7 +365,7 @@ bool ScriptTranslation::Evaluate(Dictionary* dict, UserDictionary* user_dict) {
   // make sentences when there is no exact-matching phrase candidate
   bool has_exact_match_phrase =
       phrase_ && phrase_iter_->first == consumed &&
-      is_exact_match_phrase(phrase_iter_->second.Peek());
+      is_exact_match_phrase(phrase_iter_->second.PeekView());
   bool has_exact_match_user_phrase =
       user_phrase_ && user_phrase_iter_->first == consumed &&
       is_exact_match_phrase(user_phrase_iter_->second.Peek());
@@ -475,8 +466,6 @@ bool ScriptTranslation::PreferUserPhrase() {
   int phrase_code_length = 0;
   if (phrase_ && phrase_iter_ != phrase_->rend()) {
     phrase_code_length = phrase_iter_->first;
-    DictEntryIterator& iter = phrase_iter_->second;
-    const auto& entry = iter.Peek();
   }
 
   return user_phrase_code_length > 0 &&
@@ -556,7 +545,30 @@ an<Sentence> ScriptTranslation::MakeSentence(Dictionary* dict,
                                              UserDictionary* user_dict) {
   const int kMaxSyllablesForUserPhraseQuery = 5;
   const auto& syllable_graph = syllabifier_->syllable_graph();
+  // look up the static dictionary on worker threads, if enabled;
+  // the user dictionary keeps mutable state and is queried in this thread.
+  // results are merged in the order of start positions either way.
+  vector<std::future<an<DictEntryCollector>>> phrases;
+  BOOST_SCOPE_EXIT((&phrases)) {
+    // the jobs refer to the syllable graph; wait for them even if the user
+    // dictionary throws
+    for (auto& phrase : phrases) {
+      if (phrase.valid())
+        phrase.wait();
+    }
+  }
+  BOOST_SCOPE_EXIT_END
+  if (translator_->parallel_lookup() && syllable_graph.edges.size() > 1) {
+    auto& pool = WorkerPool::Shared();
+    for (const auto& x : syllable_graph.edges) {
+      size_t start_pos = x.first;
+      phrases.push_back(pool.Post([dict, &syllable_graph, start_pos] {
+        return dict->Lookup(syllable_graph, start_pos);
+      }));
+    }
+  }
   WordGraph graph;
+  size_t i = 0;
   for (const auto& x : syllable_graph.edges) {
     auto& same_start_pos = graph[x.first];
     if (user_dict) {
@@ -565,7 +577,9 @@ an<Sentence> ScriptTranslation::MakeSentence(Dictionary* dict,
                                       kMaxSyllablesForUserPhraseQuery));
     }
     // merge lookup results
-    EnrollEntries(same_start_pos, dict->Lookup(syllable_graph, x.first));
+    EnrollEntries(same_start_pos, !phrases.empty()
+                                      ? phrases[i++].get()
+                                      : dict->Lookup(syllable_graph, x.first));
   }
   if (auto sentence =
           poet_->MakeSentence(graph, syllable_graph.interpreted_length,
@@ -43,6 +43,9 @@ class ScriptTranslator : public Translator,
   bool always_show_comments() const { return always_show_comments_; }
   bool enable_sentence() const { return enable_sentence_; }
   bool encode_commit_history() const { return encode_commit_history_; }
+  bool parallel_lookup() const { return parallel_lookup_; }
+
+  SyllabifierCache* syllabifier_cache() { return &syllabifier_cache_; }
 
  protected:
   int max_homophones_ = 16;
@@ -52,8 +55,11 @@ class ScriptTranslator : public Translator,
   bool enable_sentence_ = true;
   bool encode_commit_history_ = true;
   bool combine_candidates_ = true;
+  bool parallel_lookup_ = false;
   the<Corrector> corrector_;
   the<Poet> poet_;
+  // spellings matched in the previous input, to syllabify incrementally
+  SyllabifierCache syllabifier_cache_;
 };
 
 class ScriptSyllabifier : public PhraseSyllabifier {
@@ -71,6 +77,7 @@ class ScriptSyllabifier : public PhraseSyllabifier {
     if (corrector) {
       syllabifier_.EnableCorrection(corrector);
     }
+    syllabifier_.EnableCache(translator->syllabifier_cache());
   }
 
   virtual Spans Syllabify(const Phrase* phrase);
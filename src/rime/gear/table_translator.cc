@@ -110,7 +110,7 @@ bool TableTranslation::PreferUserPhrase() {
     return false;
   if (iter_.exhausted())
     return true;
-  if (iter_.Peek()->remaining_code_length == 0 &&
+  if (iter_.PeekView().remaining_code_length == 0 &&
       (uter_.Peek()->remaining_code_length != 0 ||
        is_constructed(uter_.Peek().get())))
     return false;
@@ -21,31 +21,51 @@ class UniquifiedTranslation : public CacheTranslation {
 
  protected:
   bool Uniquify();
+  CandidateList::iterator FindTextMatch(const string& text);
+  void IndexCandidates();
 
   an<Translation> translation_;
   CandidateList* candidates_;
+  // text => position of the first candidate with that text in candidates_
+  hash_map<string, size_t> text_index_;
+  // number of leading candidates covered by text_index_
+  size_t indexed_ = 0;
 };
 
 bool UniquifiedTranslation::Next() {
   return CacheTranslation::Next() && Uniquify();
 }
 
-static CandidateList::iterator find_text_match(const an<Candidate>& target,
-                                               CandidateList::iterator begin,
-                                               CandidateList::iterator end) {
-  for (auto iter = begin; iter != end; ++iter) {
-    if ((*iter)->text() == target->text()) {
-      return iter;
-    }
+void UniquifiedTranslation::IndexCandidates() {
+  if (indexed_ > candidates_->size()) {
+    text_index_.clear();
+    indexed_ = 0;
+  }
+  // candidates are appended by the menu after passing the filters
+  for (; indexed_ < candidates_->size(); ++indexed_) {
+    text_index_.emplace((*candidates_)[indexed_]->text(), indexed_);
   }
-  return end;
+}
+
+CandidateList::iterator UniquifiedTranslation::FindTextMatch(
+    const string& text) {
+  IndexCandidates();
+  auto found = text_index_.find(text);
+  if (found == text_index_.end())
+    return candidates_->end();
+  auto match = candidates_->begin() + found->second;
+  if ((*match)->text() == text)
+    return match;
+  // candidates have been modified in place; start over
+  text_index_.clear();
+  indexed_ = 0;
+  return FindTextMatch(text);
 }
 
 bool UniquifiedTranslation::Uniquify() {
   while (!exhausted()) {
     auto next = Peek();
-    CandidateList::iterator previous =
-        find_text_match(next, candidates_->begin(), candidates_->end());
+    CandidateList::iterator previous = FindTextMatch(next->text());
     if (previous == candidates_->end()) {
       // Encountered a unique candidate.
       return true;
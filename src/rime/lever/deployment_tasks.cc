@@ -8,6 +8,7 @@
 #include <rime/build_config.h>
 
 #include <algorithm>
+#include <numeric>
 #include <boost/algorithm/string.hpp>
 #include <filesystem>
 #include <boost/uuid/random_generator.hpp>
@@ -19,6 +20,7 @@
 #include <rime/service.h>
 #include <rime/setup.h>
 #include <rime/ticket.h>
+#include <rime/worker_pool.h>
 #include <rime/algo/fs.h>
 #include <rime/algo/utilities.h>
 #include <rime/dict/dictionary.h>
@@ -197,6 +199,7 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
   int success = 0;
   int failure = 0;
   map<string, path> schemas;
+  vector<the<DictionaryBuild>> dictionary_builds;
   the<ResourceResolver> resolver(Service::instance().CreateResourceResolver(
       {"schema_source_file", "", ".schema.yaml"}));
   auto build_schema = [&](const string& schema_id, bool as_dependency = false) {
@@ -220,11 +223,14 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
       }
       return;
     }
-    the<DeploymentTask> t(new SchemaUpdate(schema_path, build_dictionary_));
-    if (t->Run(deployer))
+    SchemaUpdate schema_update(schema_path, build_dictionary_);
+    the<DictionaryBuild> dictionary_build;
+    if (!schema_update.Prepare(deployer, &dictionary_build))
+      ++failure;
+    else if (!dictionary_build)
       ++success;
     else
-      ++failure;
+      dictionary_builds.push_back(std::move(dictionary_build));
   };
   auto schema_component = Config::Require("schema");
   for (auto it = schema_list->begin(); it != schema_list->end(); ++it) {
@@ -250,6 +256,9 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
       }
     }
   }
+  int num_built = BuildDictionaries(deployer, dictionary_builds);
+  success += num_built;
+  failure += dictionary_builds.size() - num_built;
   LOG(INFO) << "finished updating schemas: " << success << " success, "
             << failure << " failure.";
 
@@ -260,6 +269,95 @@ bool WorkspaceUpdate::Run(Deployer* deployer) {
   return failure == 0;
 }
 
+int WorkspaceUpdate::BuildDictionaries(
+    Deployer* deployer,
+    const vector<the<DictionaryBuild>>& builds) {
+  const size_t num_builds = builds.size();
+  if (num_builds == 0)
+    return 0;
+  // builds writing to a common file are grouped to run in order, while
+  // those doing the same work as an earlier build share its result.
+  vector<size_t> group(num_builds);
+  std::iota(group.begin(), group.end(), 0);
+  auto find_group = [&group](size_t i) {
+    while (group[i] != i)
+      i = group[i] = group[group[i]];
+    return i;
+  };
+  vector<size_t> same_as(num_builds);
+  map<string, size_t> signatures;
+  map<string, size_t> writers;
+  for (size_t i = 0; i < num_builds; ++i) {
+    auto inserted = signatures.emplace(builds[i]->signature(), i);
+    same_as[i] = inserted.first->second;
+    if (!inserted.second) {
+      LOG(INFO) << "dictionary '" << builds[i]->dict_name()
+                << "' is shared with an earlier schema.";
+      continue;
+    }
+    for (const auto& output : builds[i]->outputs()) {
+      auto writer = writers.emplace(output, i).first;
+      group[find_group(i)] = find_group(writer->second);
+    }
+  }
+  map<size_t, vector<size_t>> jobs;
+  for (size_t i = 0; i < num_builds; ++i) {
+    if (same_as[i] == i)
+      jobs[find_group(i)].push_back(i);
+  }
+  size_t num_workers =
+      std::min<size_t>(jobs.size(), std::thread::hardware_concurrency());
+  // the memory limit is for the deployment, not for each of parallel builds
+  if (std::any_of(builds.begin(), builds.end(), [](const auto& build) {
+        return build->table_memory_limit() > 0;
+      })) {
+    num_workers = 1;
+  }
+  LOG(INFO) << "building " << jobs.size() << " dictionary group(s) with "
+            << num_workers << " worker(s).";
+  WorkerPool pool(num_workers > 1 ? num_workers : 0);
+  // dict files are parsed on a pool of their own: not the shared one kept
+  // for lookups while typing, nor the one above whose workers wait for them.
+  const size_t kMaxParsers = 4;
+  WorkerPool parser_pool(std::min<size_t>(
+      kMaxParsers, std::max(1u, std::thread::hardware_concurrency()) - 1));
+  for (const auto& build : builds)
+    build->set_parser_pool(&parser_pool);
+  // written by one job each
+  vector<char> results(num_builds, false);
+  vector<std::future<void>> pending;
+  for (const auto& job : jobs) {
+    const vector<size_t>& members = job.second;
+    pending.push_back(pool.Post([&builds, &results, &members] {
+      // a failed build leaves the rest of its group to run
+      for (size_t i : members) {
+        try {
+          results[i] = builds[i]->Run();
+        } catch (const std::exception& ex) {
+          LOG(ERROR) << "error building dictionary '" << builds[i]->dict_name()
+                     << "': " << ex.what();
+        } catch (...) {
+          LOG(ERROR) << "error building dictionary '"
+                     << builds[i]->dict_name() << "'.";
+        }
+      }
+    }));
+  }
+  size_t num_done = 0;
+  for (auto& job : pending) {
+    job.wait();
+    deployer->message_sink()(
+        "deploy_progress",
+        std::to_string(++num_done) + "/" + std::to_string(jobs.size()));
+  }
+  int num_succeeded = 0;
+  for (size_t i = 0; i < num_builds; ++i) {
+    if (results[same_as[i]])
+      ++num_succeeded;
+  }
+  return num_succeeded;
+}
+
 SchemaUpdate::SchemaUpdate(TaskInitializer arg) : verbose_(false) {
   try {
     auto p = std::any_cast<pair<path, bool>>(arg);
@@ -334,6 +432,15 @@ static bool TrashDeprecatedUserCopy(const path& shared_copy,
 }
 
 bool SchemaUpdate::Run(Deployer* deployer) {
+  the<DictionaryBuild> dictionary_build;
+  if (!Prepare(deployer, &dictionary_build))
+    return false;
+  return !dictionary_build || dictionary_build->Run();
+}
+
+bool SchemaUpdate::Prepare(Deployer* deployer,
+                           the<DictionaryBuild>* dictionary_build) {
+  dictionary_build->reset();
   if (!fs::exists(source_path_)) {
     LOG(ERROR) << "Error updating schema: nonexistent file '" << source_path_
                << "'.";
@@ -371,23 +478,83 @@ bool SchemaUpdate::Run(Deployer* deployer) {
   }
 
   LOG(INFO) << "preparing dictionary '" << dict_name << "'.";
-  const path& user_data_path(deployer->user_data_dir);
   if (!MaybeCreateDirectory(deployer->staging_dir)) {
     return false;
   }
-  DictCompiler dict_compiler(dict.get());
-  if (verbose_) {
-    dict_compiler.set_options(DictCompiler::kRebuild | DictCompiler::kDump);
-  }
   the<ResourceResolver> resolver(
       Service::instance().CreateDeployedResourceResolver(
           {"compiled_schema", "", ".schema.yaml"}));
   auto compiled_schema = resolver->ResolvePath(schema_id);
-  if (!dict_compiler.Compile(compiled_schema)) {
-    LOG(ERROR) << "dictionary '" << dict_name << "' failed to compile.";
+  dictionary_build->reset(
+      new DictionaryBuild(std::move(dict), compiled_schema, verbose_));
+  return true;
+}
+
+// DictionaryBuild
+
+DictionaryBuild::DictionaryBuild(the<Dictionary> dict,
+                                 const path& compiled_schema,
+                                 bool verbose)
+    : dict_name_(dict->name()),
+      dict_(std::move(dict)),
+      compiler_(new DictCompiler(dict_.get())),
+      compiled_schema_(compiled_schema) {
+  if (verbose) {
+    compiler_->set_options(DictCompiler::kRebuild | DictCompiler::kDump);
+  }
+  // bounds memory used for building tables on low-memory devices, not
+  // counting the entries collected from dict files before they are sorted.
+  the<Config> config(Config::Require("config")->Create("default"));
+  int table_memory_limit = 0;
+  if (config &&
+      config->GetInt("dict_compiler/table_memory_limit", &table_memory_limit) &&
+      table_memory_limit > 0) {
+    table_memory_limit_ = table_memory_limit;
+    compiler_->set_table_memory_limit(table_memory_limit_);
+  }
+  // 5 for tables faster to look up, which older versions can't read
+  int table_format = 0;
+  if (config && config->GetInt("dict_compiler/table_format", &table_format) &&
+      (table_format == 4 || table_format == 5)) {
+    compiler_->set_table_format_version(table_format);
+  }
+  for (const auto& table : dict_->tables()) {
+    if (table)
+      outputs_.push_back(table->file_path().u8string());
+  }
+  if (dict_->prism())
+    outputs_.push_back(dict_->prism()->file_path().u8string());
+  Sign();
+  signature_ += std::to_string(Checksum(compiled_schema_));
+  if (verbose)
+    signature_ += "\nverbose";
+}
+
+DictionaryBuild::DictionaryBuild(const string& dict_name,
+                                 const vector<string>& outputs)
+    : dict_name_(dict_name), outputs_(outputs) {
+  Sign();
+}
+
+DictionaryBuild::~DictionaryBuild() {}
+
+void DictionaryBuild::set_parser_pool(WorkerPool* pool) {
+  if (compiler_)
+    compiler_->set_parser_pool(pool);
+}
+
+void DictionaryBuild::Sign() {
+  for (const auto& output : outputs_) {
+    signature_ += output + '\n';
+  }
+}
+
+bool DictionaryBuild::Run() {
+  if (!compiler_->Compile(compiled_schema_)) {
+    LOG(ERROR) << "dictionary '" << dict_name() << "' failed to compile.";
     return false;
   }
-  LOG(INFO) << "dictionary '" << dict_name << "' is ready.";
+  LOG(INFO) << "dictionary '" << dict_name() << "' is ready.";
   return true;
 }
 
@@ -12,6 +12,45 @@
 
 namespace rime {
 
+class DictCompiler;
+class Dictionary;
+class WorkerPool;
+
+// compiles the dictionary of a schema. it is prepared by SchemaUpdate in the
+// deployer's thread, and can run in any thread.
+class RIME_API DictionaryBuild {
+ public:
+  DictionaryBuild(the<Dictionary> dict,
+                  const path& compiled_schema,
+                  bool verbose);
+  virtual ~DictionaryBuild();
+
+  virtual bool Run();
+
+  const string& dict_name() const { return dict_name_; }
+  // files written by the build; builds sharing any of them run in order.
+  const vector<string>& outputs() const { return outputs_; }
+  // builds of the same signature do the same work.
+  const string& signature() const { return signature_; }
+  // parses dict files ahead on the pool.
+  void set_parser_pool(WorkerPool* pool);
+  // bytes of entries held in memory to build a table; 0 if unlimited.
+  size_t table_memory_limit() const { return table_memory_limit_; }
+
+ protected:
+  // a build of another kind, which writes the given files.
+  DictionaryBuild(const string& dict_name, const vector<string>& outputs);
+  void Sign();
+
+  string dict_name_;
+  the<Dictionary> dict_;
+  the<DictCompiler> compiler_;
+  path compiled_schema_;
+  vector<string> outputs_;
+  string signature_;
+  size_t table_memory_limit_ = 0;
+};
+
 // detects changes in either user configuration or upgraded shared data
 class DetectModifications : public DeploymentTask {
  public:
@@ -43,6 +82,10 @@ class RIME_API WorkspaceUpdate : public DeploymentTask {
   string GetSchemaPath(Deployer* deployer,
                        const string& schema_id,
                        bool prefer_shared_copy);
+  // builds dictionaries in parallel, returning the number of successful
+  // builds.
+  int BuildDictionaries(Deployer* deployer,
+                        const vector<the<DictionaryBuild>>& builds);
   bool build_dictionary_;
 };
 
@@ -54,6 +97,9 @@ class RIME_API SchemaUpdate : public DeploymentTask {
       : source_path_(source_path), build_dictionary_(build_dictionary) {}
   SchemaUpdate(TaskInitializer arg);
   bool Run(Deployer* deployer);
+  // updates the schema, leaving its dictionary to be built by the caller.
+  // dictionary_build is reset if there is no dictionary to build.
+  bool Prepare(Deployer* deployer, the<DictionaryBuild>* dictionary_build);
   void set_verbose(bool verbose) { verbose_ = verbose; }
 
  protected:
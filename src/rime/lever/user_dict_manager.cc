@@ -14,12 +14,23 @@
 #include <rime/dict/db_utils.h>
 #include <rime/dict/table_db.h>
 #include <rime/dict/user_db.h>
+#include <rime/dict/user_dictionary.h>
 #include <rime/lever/user_dict_manager.h>
 
 namespace fs = std::filesystem;
 
 namespace rime {
 
+// writes back the updates the open sessions hold in memory.
+static void FlushPendingUpdates(const string& dict_name) {
+  auto* component = dynamic_cast<UserDictionaryComponent*>(
+      UserDictionary::Require("user_dictionary"));
+  if (component && !component->FlushPendingUpdates(dict_name)) {
+    LOG(WARNING) << "failed to write back updates to user dict '"
+                 << dict_name << "'.";
+  }
+}
+
 UserDictManager::UserDictManager(Deployer* deployer)
     : deployer_(deployer), user_db_component_(UserDb::Require("userdb")) {
   if (deployer) {
@@ -49,6 +60,7 @@ void UserDictManager::GetUserDictList(UserDictList* user_dict_list,
 }
 
 bool UserDictManager::Backup(const string& dict_name) {
+  FlushPendingUpdates(dict_name);
   the<Db> db(user_db_component_->Create(dict_name));
   if (!db->OpenReadOnly())
     return false;
@@ -88,6 +100,7 @@ bool UserDictManager::Restore(const path& snapshot_file) {
   string db_name = UserDbHelper(temp).GetDbName();
   if (db_name.empty())
     return false;
+  FlushPendingUpdates(db_name);
   the<Db> dest(user_db_component_->Create(db_name));
   if (!dest->Open())
     return false;
@@ -105,6 +118,7 @@ bool UserDictManager::Restore(const path& snapshot_file) {
 }
 
 int UserDictManager::Export(const string& dict_name, const path& text_file) {
+  FlushPendingUpdates(dict_name);
   the<Db> db(user_db_component_->Create(dict_name));
   if (!db->OpenReadOnly())
     return -1;
@@ -129,6 +143,7 @@ int UserDictManager::Export(const string& dict_name, const path& text_file) {
 }
 
 int UserDictManager::Import(const string& dict_name, const path& text_file) {
+  FlushPendingUpdates(dict_name);
   the<Db> db(user_db_component_->Create(dict_name));
   if (!db->Open())
     return -1;
@@ -148,6 +163,10 @@ int UserDictManager::Import(const string& dict_name, const path& text_file) {
     return -1;
   }
   DLOG(INFO) << num_entries << " entries imported.";
+  if (num_entries > 0) {
+    // sessions re-read the tick count and rebuild the index
+    UserDb::NewGeneration();
+  }
   return num_entries;
 }
 
@@ -6,9 +6,11 @@
 //
 #include <rime/context.h>
 #include <rime/engine.h>
+#include <rime/key_event.h>
 #include <rime/resource.h>
 #include <rime/schema.h>
 #include <rime/service.h>
+#include <rime/dict/user_dictionary.h>
 
 using namespace std::placeholders;
 
@@ -26,6 +28,22 @@ bool Session::ProcessKey(const KeyEvent& key_event) {
   return engine_->ProcessKey(key_event);
 }
 
+size_t Session::ProcessKeys(const KeySequence& keys, vector<bool>* results) {
+  Context* ctx = engine_->context();
+  bool was_lazy = ctx->lazy_composition();
+  ctx->set_lazy_composition(true);
+  size_t accepted = 0;
+  for (const KeyEvent& key_event : keys) {
+    bool result = engine_->ProcessKey(key_event);
+    if (result)
+      ++accepted;
+    if (results)
+      results->push_back(result);
+  }
+  ctx->set_lazy_composition(was_lazy);
+  return accepted;
+}
+
 void Session::Activate() {
   last_active_time_ = time(NULL);
 }
@@ -139,6 +157,12 @@ void Service::CleanupStaleSessions() {
   if (count > 0) {
     LOG(INFO) << "Recycled " << count << " stale sessions.";
   }
+  // frontends call this when idle; write back the user dictionary updates
+  // that have been held in memory for long.
+  if (auto* user_dictionary = dynamic_cast<UserDictionaryComponent*>(
+          UserDictionary::Require("user_dictionary"))) {
+    user_dictionary->FlushPendingUpdates();
+  }
 }
 
 void Service::CleanupAllSessions() {
@@ -12,6 +12,7 @@
 #include <mutex>
 #include <rime/common.h>
 #include <rime/deployer.h>
+#include <rime_api.h>
 
 namespace rime {
 
@@ -26,14 +27,30 @@ using NotificationHandler = function<void(SessionId session_id,
 class Context;
 class Engine;
 class KeyEvent;
+class KeySequence;
 class Schema;
 
+// strings and arrays referenced by the RimeContextView of a session,
+// reused across calls.
+struct ContextViewBuffer {
+  // null-terminated strings, one after another
+  string text;
+  vector<RimeCandidateView> candidates;
+  vector<RimeStringSlice> select_labels;
+  // slices to point into text, with the offsets of their strings
+  vector<std::pair<RimeStringSlice*, size_t>> slices;
+};
+
 class Session {
  public:
   static const int kLifeSpan = 5 * 60;  // seconds
 
   Session();
   bool ProcessKey(const KeyEvent& key_event);
+  // composes once after the last key, unless the context is read between
+  // keys. returns the number of keys accepted; if results is given, it
+  // records whether each key was accepted.
+  size_t ProcessKeys(const KeySequence& keys, vector<bool>* results = nullptr);
   void Activate();
   void ResetCommitText();
   bool CommitComposition();
@@ -44,6 +61,7 @@ class Session {
   Schema* schema() const;
   time_t last_active_time() const { return last_active_time_; }
   const string& commit_text() const { return commit_text_; }
+  ContextViewBuffer& context_view_buffer() { return context_view_buffer_; }
 
  private:
   void OnCommit(const string& commit_text);
@@ -51,6 +69,7 @@ class Session {
   the<Engine> engine_;
   time_t last_active_time_ = 0;
   string commit_text_;
+  ContextViewBuffer context_view_buffer_;
 };
 
 class ResourceResolver;
@@ -4,6 +4,7 @@
 //
 // 2011-05-21 GONG Chen <chen.sst@gmail.com>
 //
+#include <algorithm>
 #include <rime/candidate.h>
 #include <rime/translation.h>
 #include <rime/gear/translator_commons.h>
@@ -113,7 +114,8 @@ bool MergedTranslation::Next() {
     DLOG(INFO) << "translation #" << elected_ << " has been exhausted.";
     translations_.erase(translations_.begin() + elected_);
   }
-  Elect();
+  // only the comparison with its predecessor is affected
+  Elect(elected_ > 0 ? elected_ - 1 : 0);
   return !exhausted();
 }
 
@@ -124,24 +126,26 @@ an<Candidate> MergedTranslation::Peek() {
   return translations_[elected_]->Peek();
 }
 
-void MergedTranslation::Elect() {
+void MergedTranslation::Elect(size_t start) {
   if (translations_.empty()) {
     set_exhausted(true);
     return;
   }
-  size_t k = 0;
-  for (; k < translations_.size(); ++k) {
+  size_t k = (std::min)(start, translations_.size() - 1);
+  while (k < translations_.size()) {
     const auto& current = translations_[k];
     const auto& next =
         k + 1 < translations_.size() ? translations_[k + 1] : nullptr;
     if (current->Compare(next, previous_candidates_) <= 0) {
       if (current->exhausted()) {
         translations_.erase(translations_.begin() + k);
-        k = 0;
+        // its predecessor now faces a new opponent
+        k = k > 0 ? k - 1 : 0;
         continue;
       }
       break;
     }
+    ++k;
   }
   elected_ = k;
   if (k >= translations_.size()) {
@@ -154,8 +158,11 @@ void MergedTranslation::Elect() {
 
 MergedTranslation& MergedTranslation::operator+=(an<Translation> t) {
   if (t && !t->exhausted()) {
+    bool was_exhausted = exhausted();
     translations_.push_back(t);
-    Elect();
+    // the new translation challenges the last one, or the elected one if
+    // it comes before the last
+    Elect(was_exhausted ? 0 : (std::min)(elected_, translations_.size() - 2));
   }
   return *this;
 }
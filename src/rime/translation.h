@@ -94,7 +94,10 @@ class MergedTranslation : public Translation {
   size_t size() const { return translations_.size(); }
 
  protected:
-  void Elect();
+  // elects the first translation that is no worse than the next one.
+  // comparisons between translations before `start` are known to have
+  // failed and are not repeated.
+  void Elect(size_t start = 0);
 
   const CandidateList& previous_candidates_;
   vector<of<Translation>> translations_;
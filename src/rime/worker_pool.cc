@@ -0,0 +1,73 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <rime/worker_pool.h>
+
+namespace rime {
+
+WorkerPool::WorkerPool(size_t num_workers) {
+#ifndef RIME_NO_THREADING
+  for (size_t i = 0; i < num_workers; ++i) {
+    workers_.emplace_back([this] { Work(); });
+  }
+#endif
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::Enqueue(function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push(std::move(job));
+  }
+  job_available_.notify_one();
+}
+
+void WorkerPool::Work() {
+  while (true) {
+    function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_available_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty())
+        return;
+      job = std::move(jobs_.front());
+      jobs_.pop();
+    }
+    job();
+  }
+}
+
+static std::mutex shared_pool_mutex;
+static WorkerPool* shared_pool = nullptr;
+
+WorkerPool& WorkerPool::Shared() {
+  const size_t kMaxSharedWorkers = 4;
+  std::lock_guard<std::mutex> lock(shared_pool_mutex);
+  if (!shared_pool) {
+    // leave a core to the calling thread
+    shared_pool = new WorkerPool(std::min<size_t>(
+        kMaxSharedWorkers,
+        std::max(1u, std::thread::hardware_concurrency()) - 1));
+  }
+  return *shared_pool;
+}
+
+void WorkerPool::ShutdownShared() {
+  std::lock_guard<std::mutex> lock(shared_pool_mutex);
+  delete shared_pool;
+  shared_pool = nullptr;
+}
+
+}  // namespace rime
@@ -0,0 +1,62 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#ifndef RIME_WORKER_POOL_H_
+#define RIME_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <rime_api.h>
+#include <rime/common.h>
+
+namespace rime {
+
+// a fixed number of threads running short-lived jobs in FIFO order.
+// jobs run in the calling thread if the pool has no workers.
+class WorkerPool {
+ public:
+  RIME_API explicit WorkerPool(size_t num_workers);
+  RIME_API ~WorkerPool();
+
+  template <class F>
+  std::future<std::invoke_result_t<F>> Post(F&& job) {
+    using R = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(job));
+    auto result = task->get_future();
+    if (workers_.empty()) {
+      (*task)();
+    } else {
+      Enqueue([task] { (*task)(); });
+    }
+    return result;
+  }
+
+  size_t num_workers() const { return workers_.size(); }
+
+  // a small pool shared by components for parallel queries, sized by the
+  // number of available cores. created on first use.
+  RIME_API static WorkerPool& Shared();
+  // joins the threads of the shared pool, which is otherwise left to exit
+  // with the process, as joining threads in static destructors may
+  // deadlock. no job may be posted to it meanwhile.
+  RIME_API static void ShutdownShared();
+
+ private:
+  RIME_API void Enqueue(function<void()> job);
+  void Work();
+
+  vector<std::thread> workers_;
+  std::queue<function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable job_available_;
+  bool stopping_ = false;
+};
+
+}  // namespace rime
+
+#endif  // RIME_WORKER_POOL_H_
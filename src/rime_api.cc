@@ -20,6 +20,7 @@
 #include <rime/setup.h>
 #include <rime/signature.h>
 #include <rime/switches.h>
+#include <rime/worker_pool.h>
 #include <rime_api.h>
 
 using namespace rime;
@@ -82,6 +83,7 @@ RIME_API void RimeInitialize(RimeTraits* traits) {
 RIME_API void RimeFinalize() {
   RimeJoinMaintenanceThread();
   Service::instance().StopService();
+  WorkerPool::ShutdownShared();
   Registry::instance().Clear();
   ModuleManager::instance().UnloadModules();
 }
@@ -213,6 +215,30 @@ RIME_API Bool RimeProcessKey(RimeSessionId session_id, int keycode, int mask) {
   return Bool(session->ProcessKey(KeyEvent(keycode, mask)));
 }
 
+RIME_API int RimeProcessKeys(RimeSessionId session_id,
+                             const int* keycodes,
+                             const int* masks,
+                             int count,
+                             Bool* accepted) {
+  if (!keycodes || count <= 0)
+    return 0;
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return 0;
+  KeySequence keys;
+  keys.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    keys.push_back(KeyEvent(keycodes[i], masks ? masks[i] : 0));
+  }
+  vector<bool> results;
+  size_t num_accepted =
+      session->ProcessKeys(keys, accepted ? &results : nullptr);
+  for (size_t i = 0; i < results.size(); ++i) {
+    accepted[i] = Bool(results[i]);
+  }
+  return static_cast<int>(num_accepted);
+}
+
 RIME_API Bool RimeCommitComposition(RimeSessionId session_id) {
   an<Session> session(Service::instance().GetSession(session_id));
   if (!session)
@@ -338,6 +364,111 @@ RIME_API Bool RimeFreeContext(RimeContext* context) {
   return True;
 }
 
+namespace {
+
+// appends strings to a view buffer, and points slices to them once the
+// buffer stops growing. slices in the arrays of the buffer must not move,
+// so the arrays are sized before writing to them.
+class ContextViewWriter {
+ public:
+  explicit ContextViewWriter(ContextViewBuffer* buffer) : buffer_(buffer) {
+    buffer_->text.clear();
+    buffer_->candidates.clear();
+    buffer_->select_labels.clear();
+    buffer_->slices.clear();
+  }
+
+  void Write(RimeStringSlice* slice, const string& str) {
+    buffer_->slices.push_back({slice, buffer_->text.length()});
+    slice->length = str.length();
+    buffer_->text.append(str);
+    buffer_->text.push_back('\0');
+  }
+
+  void WriteIfNotEmpty(RimeStringSlice* slice, const string& str) {
+    if (!str.empty())
+      Write(slice, str);
+  }
+
+  void Finish() {
+    for (const auto& pending : buffer_->slices) {
+      pending.first->str = buffer_->text.data() + pending.second;
+    }
+    buffer_->slices.clear();
+  }
+
+ private:
+  ContextViewBuffer* buffer_;
+};
+
+}  // namespace
+
+RIME_API Bool RimeGetContextView(RimeSessionId session_id,
+                                 RimeContextView* view) {
+  if (!view || view->data_size <= 0)
+    return False;
+  RIME_STRUCT_CLEAR(*view);
+  an<Session> session(Service::instance().GetSession(session_id));
+  if (!session)
+    return False;
+  Context* ctx = session->context();
+  if (!ctx)
+    return False;
+  ContextViewBuffer& buffer = session->context_view_buffer();
+  ContextViewWriter writer(&buffer);
+  if (ctx->IsComposing()) {
+    Preedit preedit = ctx->GetPreedit();
+    writer.Write(&view->preedit, preedit.text);
+    view->cursor_pos = preedit.caret_pos;
+    view->sel_start = preedit.sel_start;
+    view->sel_end = preedit.sel_end;
+    writer.WriteIfNotEmpty(&view->commit_text_preview, ctx->GetCommitText());
+  }
+  if (ctx->HasMenu()) {
+    Segment& seg(ctx->composition().back());
+    int page_size = 5;
+    Schema* schema = session->schema();
+    if (schema)
+      page_size = schema->page_size();
+    int selected_index = seg.selected_index;
+    int page_no = selected_index / page_size;
+    the<Page> page(seg.menu->CreatePage(page_size, page_no));
+    if (page) {
+      view->page_size = page_size;
+      view->page_no = page_no;
+      view->is_last_page = Bool(page->is_last_page);
+      view->highlighted_candidate_index = selected_index % page_size;
+      buffer.candidates.resize(page->candidates.size());
+      size_t i = 0;
+      for (const an<Candidate>& cand : page->candidates) {
+        RimeCandidateView& dest = buffer.candidates[i++];
+        writer.Write(&dest.text, cand->text());
+        dest.comment = {nullptr, 0};
+        writer.WriteIfNotEmpty(&dest.comment, cand->comment());
+        dest.quality = cand->quality();
+      }
+      view->num_candidates = buffer.candidates.size();
+      view->candidates = buffer.candidates.data();
+      if (schema) {
+        writer.WriteIfNotEmpty(&view->select_keys, schema->select_keys());
+        Config* config = schema->config();
+        an<ConfigList> select_labels =
+            config->GetList("menu/alternative_select_labels");
+        if (select_labels && (size_t)page_size <= select_labels->size()) {
+          buffer.select_labels.resize(page_size);
+          for (size_t i = 0; i < (size_t)page_size; ++i) {
+            an<ConfigValue> value = select_labels->GetValueAt(i);
+            writer.Write(&buffer.select_labels[i], value->str());
+          }
+          view->select_labels = buffer.select_labels.data();
+        }
+      }
+    }
+  }
+  writer.Finish();
+  return True;
+}
+
 RIME_API Bool RimeGetCommit(RimeSessionId session_id, RimeCommit* commit) {
   if (!commit)
     return False;
@@ -800,9 +931,7 @@ RIME_API Bool RimeSimulateKeySequence(RimeSessionId session_id,
     LOG(ERROR) << "error parsing input: '" << key_sequence << "'";
     return False;
   }
-  for (const KeyEvent& key : keys) {
-    session->ProcessKey(key);
-  }
+  session->ProcessKeys(keys);
   return True;
 }
 
@@ -1365,6 +1494,8 @@ RIME_API RimeApi* rime_get_api() {
     s_api.highlight_candidate_on_current_page =
         &RimeHighlightCandidateOnCurrentPage;
     s_api.change_page = &RimeChangePage;
+    s_api.get_context_view = &RimeGetContextView;
+    s_api.process_keys = &RimeProcessKeys;
   }
   return &s_api;
 }
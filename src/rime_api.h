@@ -206,6 +206,36 @@ typedef struct rime_string_slice_t {
   size_t length;
 } RimeStringSlice;
 
+typedef struct rime_candidate_view_t {
+  RimeStringSlice text;
+  RimeStringSlice comment;
+  double quality;
+} RimeCandidateView;
+
+/*!
+ *  A view of the context borrowing strings from the session.
+ *  Should be initialized by calling RIME_STRUCT_INIT(Type, var);
+ */
+typedef struct rime_context_view_t {
+  int data_size;
+  // composition
+  RimeStringSlice preedit;
+  int cursor_pos;
+  int sel_start;
+  int sel_end;
+  RimeStringSlice commit_text_preview;
+  // menu
+  int page_size;
+  int page_no;
+  Bool is_last_page;
+  int highlighted_candidate_index;
+  int num_candidates;
+  const RimeCandidateView* candidates;
+  RimeStringSlice select_keys;
+  //! page_size labels, or NULL if not configured.
+  const RimeStringSlice* select_labels;
+} RimeContextView;
+
 // Setup
 
 /*!
@@ -275,6 +305,19 @@ RIME_API void RimeCleanupAllSessions(void);
 // Input
 
 RIME_API Bool RimeProcessKey(RimeSessionId session_id, int keycode, int mask);
+/*!
+ *  Processes count keys in a row, composing once after the last key unless
+ *  the context is read by a processor in between.
+ *  masks can be NULL if no modifiers are held.
+ *  If accepted is not NULL, it receives whether each key is accepted.
+ *  To compose lazily for every key, turn on option "lazy_composition".
+ *  \return the number of keys accepted
+ */
+RIME_API int RimeProcessKeys(RimeSessionId session_id,
+                             const int* keycodes,
+                             const int* masks,
+                             int count,
+                             Bool* accepted);
 /*!
  * return True if there is unread commit text
  */
@@ -287,6 +330,14 @@ RIME_API Bool RimeGetCommit(RimeSessionId session_id, RimeCommit* commit);
 RIME_API Bool RimeFreeCommit(RimeCommit* commit);
 RIME_API Bool RimeGetContext(RimeSessionId session_id, RimeContext* context);
 RIME_API Bool RimeFreeContext(RimeContext* context);
+/*!
+ *  Fills the view with strings owned by the session, without allocating
+ *  memory for each call. Strings are null-terminated, and absent ones are
+ *  {NULL, 0}. The view stays valid until the next call to this function for
+ *  the same session, or until the session is destroyed. It needs no freeing.
+ */
+RIME_API Bool RimeGetContextView(RimeSessionId session_id,
+                                 RimeContextView* view);
 RIME_API Bool RimeGetStatus(RimeSessionId session_id, RimeStatus* status);
 RIME_API Bool RimeFreeStatus(RimeStatus* status);
 
@@ -735,6 +786,16 @@ typedef struct rime_api_t {
                                               size_t index);
 
   Bool (*change_page)(RimeSessionId session_id, Bool backward);
+
+  //! get the context without copying strings. see RimeGetContextView().
+  Bool (*get_context_view)(RimeSessionId session_id, RimeContextView* view);
+
+  //! process keys in a row, see RimeProcessKeys().
+  int (*process_keys)(RimeSessionId session_id,
+                      const int* keycodes,
+                      const int* masks,
+                      int count,
+                      Bool* accepted);
 } RimeApi;
 
 //! API entry
@@ -0,0 +1,73 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/context.h>
+
+using namespace rime;
+
+class RimeContextTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    ctx_.update_notifier().connect([this](Context* ctx) { ++updates_; });
+    ctx_.compose_notifier().connect([this](Context* ctx) {
+      ++compositions_;
+      // a rough composition of the whole input, like the engine's
+      Composition& comp = ctx->composition();
+      comp.Reset(ctx->input());
+      comp.clear();
+      int length = static_cast<int>(ctx->input().length());
+      if (length > 0)
+        comp.AddSegment(Segment(0, length));
+    });
+  }
+
+  Context ctx_;
+  int updates_ = 0;
+  int compositions_ = 0;
+};
+
+TEST_F(RimeContextTest, ComposeOnEachEdit) {
+  ctx_.PushInput('a');
+  ctx_.PushInput('b');
+  EXPECT_EQ(2, compositions_);
+  EXPECT_EQ(2, updates_);
+}
+
+TEST_F(RimeContextTest, LazyComposition) {
+  ctx_.set_lazy_composition(true);
+  ctx_.PushInput('a');
+  ctx_.PushInput('b');
+  ctx_.BeginEditing();
+  EXPECT_EQ(0, compositions_);
+  // other parties are still notified of each edit
+  EXPECT_EQ(2, updates_);
+  EXPECT_EQ("ab", ctx_.input());
+  // reading the composition brings it up to date
+  ASSERT_EQ(1, ctx_.composition().size());
+  EXPECT_EQ(2, ctx_.composition().back().end);
+  EXPECT_EQ(1, compositions_);
+  ctx_.PushInput('c');
+  ctx_.PopInput();
+  ctx_.PushInput('d');
+  EXPECT_EQ(1, compositions_);
+  ctx_.set_lazy_composition(false);
+  EXPECT_EQ(2, compositions_);
+  EXPECT_EQ(3, ctx_.composition().back().end);
+  // nothing left to compose
+  ctx_.set_lazy_composition(false);
+  EXPECT_EQ(2, compositions_);
+  EXPECT_EQ(5, updates_);
+}
+
+TEST_F(RimeContextTest, ComposeBeforeClearedContextIsRead) {
+  ctx_.PushInput('a');
+  ctx_.set_lazy_composition(true);
+  ctx_.Clear();
+  EXPECT_EQ(1, compositions_);
+  EXPECT_FALSE(ctx_.IsComposing());
+  EXPECT_EQ(2, compositions_);
+  EXPECT_TRUE(ctx_.composition().empty());
+  ctx_.set_lazy_composition(false);
+}
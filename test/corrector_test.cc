@@ -5,7 +5,10 @@
 // Created by nameoverflow on 2018/11/21.
 //
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <memory>
+#include <random>
 #include <gtest/gtest.h>
 #include <rime/algo/syllabifier.h>
 #include <rime/dict/corrector.h>
@@ -156,3 +159,154 @@ TEST_F(RimeCorrectorTest, CaseMultipleEdges1) {
   ASSERT_FALSE(sp2.end() == sp2.find(syllable_id_["jue"]));
   ASSERT_TRUE(sp2[syllable_id_["jue"]].type == rime::kNormalSpelling);
 }
+
+using rime::corrector::BitParallelDistance;
+using rime::corrector::Distance;
+
+// unit-cost optimal string alignment distance, the textbook way
+static Distance ReferenceDistance(const rime::string& s1,
+                                  const rime::string& s2) {
+  size_t m = s1.length(), n = s2.length();
+  rime::vector<rime::vector<Distance>> d(m + 1, rime::vector<Distance>(n + 1));
+  for (size_t i = 0; i <= m; ++i)
+    d[i][0] = i;
+  for (size_t j = 0; j <= n; ++j)
+    d[0][j] = j;
+  for (size_t i = 1; i <= m; ++i) {
+    for (size_t j = 1; j <= n; ++j) {
+      d[i][j] = (std::min)({d[i - 1][j] + 1, d[i][j - 1] + 1,
+                            d[i - 1][j - 1] + (s1[i - 1] != s2[j - 1])});
+      if (i > 1 && j > 1 && s1[i - 2] == s2[j - 1] && s1[i - 1] == s2[j - 2])
+        d[i][j] = (std::min)(d[i][j], d[i - 2][j - 2] + 1);
+    }
+  }
+  return d[m][n];
+}
+
+static rime::string RandomString(std::mt19937& gen, size_t max_length) {
+  std::uniform_int_distribution<size_t> length(0, max_length);
+  std::uniform_int_distribution<int> letter('a', 'd');
+  rime::string s(length(gen), ' ');
+  for (auto& c : s)
+    c = (char)letter(gen);
+  return s;
+}
+
+TEST(RimeBitParallelDistanceTest, MatchesReference) {
+  EXPECT_EQ(0, BitParallelDistance("")(""));
+  EXPECT_EQ(3, BitParallelDistance("")("abc"));
+  EXPECT_EQ(1, BitParallelDistance("ab")("ba"));
+  EXPECT_EQ(3, BitParallelDistance("ca")("abc"));  // not 2 as in Damerau
+  std::mt19937 gen(42);
+  for (int n = 0; n < 2000; ++n) {
+    auto pattern = RandomString(gen, 12);
+    auto text = RandomString(gen, 12);
+    BitParallelDistance distance(pattern);
+    Distance prefix_distances[BitParallelDistance::kMaxPatternLength + 1];
+    distance.PrefixDistances(text, prefix_distances);
+    for (size_t i = 0; i <= pattern.length(); ++i) {
+      ASSERT_EQ(ReferenceDistance(pattern.substr(0, i), text),
+                prefix_distances[i])
+          << pattern << " " << text << " " << i;
+    }
+    ASSERT_EQ(ReferenceDistance(pattern, text), distance(text));
+  }
+}
+
+TEST(RimeBitParallelDistanceTest, LongPattern) {
+  rime::string pattern(64, 'a');
+  pattern[10] = 'b';
+  rime::string text(70, 'a');
+  EXPECT_EQ(ReferenceDistance(pattern, text),
+            BitParallelDistance(pattern)(text));
+}
+
+TEST(RimeBitParallelDistanceTest, BatchMatchesSingle) {
+  std::mt19937 gen(7);
+  auto pattern = RandomString(gen, 16);
+  BitParallelDistance distance(pattern);
+  // an odd number of texts of various lengths fills the lanes unevenly
+  rime::vector<rime::string> texts;
+  for (int n = 0; n < 11; ++n) {
+    texts.push_back(RandomString(gen, 20));
+  }
+  rime::vector<const rime::string*> text_ptrs;
+  for (const auto& t : texts) {
+    text_ptrs.push_back(&t);
+  }
+  rime::vector<Distance> batch;
+  distance.BatchPrefixDistances(text_ptrs, &batch);
+  const size_t row = pattern.length() + 1;
+  ASSERT_EQ(texts.size() * row, batch.size());
+  for (size_t k = 0; k < texts.size(); ++k) {
+    Distance expected[BitParallelDistance::kMaxPatternLength + 1];
+    distance.PrefixDistances(texts[k], expected);
+    for (size_t i = 0; i < row; ++i) {
+      EXPECT_EQ(expected[i], batch[k * row + i]);
+    }
+  }
+}
+
+TEST(RimeBitParallelDistanceTest, LowerBoundOfRestrictedDistance) {
+  rime::EditDistanceCorrector corrector(rime::path("unused.correction.bin"));
+  std::mt19937 gen(11);
+  for (int n = 0; n < 1000; ++n) {
+    auto s1 = RandomString(gen, 8);
+    auto s2 = RandomString(gen, 8);
+    EXPECT_LE(BitParallelDistance(s2)(s1),
+              corrector.RestrictedDistance(s1, s2, 100));
+  }
+}
+
+TEST(RimeBitParallelDistanceTest, DISABLED_BenchmarkFilterCandidates) {
+  rime::EditDistanceCorrector corrector(rime::path("unused.correction.bin"));
+  std::mt19937 gen(1);
+  rime::vector<rime::string> origins;
+  for (int n = 0; n < 400; ++n) {
+    origins.push_back(RandomString(gen, 6));
+  }
+  rime::vector<const rime::string*> origin_ptrs;
+  for (const auto& o : origins) {
+    origin_ptrs.push_back(&o);
+  }
+  rime::vector<rime::string> keys;
+  for (int n = 0; n < 2000; ++n) {
+    keys.push_back(RandomString(gen, 6));
+  }
+  const Distance threshold = 2;
+  using clock = std::chrono::steady_clock;
+
+  size_t exact_count = 0;
+  auto start = clock::now();
+  for (const auto& key : keys) {
+    for (const auto& origin : origins) {
+      if (corrector.RestrictedDistance(origin, key, threshold) <= threshold)
+        ++exact_count;
+    }
+  }
+  auto exact_time = clock::now() - start;
+
+  size_t filtered_count = 0;
+  rime::vector<Distance> distances;
+  start = clock::now();
+  for (const auto& key : keys) {
+    BitParallelDistance(key).BatchPrefixDistances(origin_ptrs, &distances);
+    const size_t row = key.length() + 1;
+    for (size_t i = 0; i < origins.size(); ++i) {
+      if (distances[i * row + key.length()] > threshold)
+        continue;
+      if (corrector.RestrictedDistance(origins[i], key, threshold) <=
+          threshold)
+        ++filtered_count;
+    }
+  }
+  auto filtered_time = clock::now() - start;
+
+  EXPECT_EQ(exact_count, filtered_count);
+  using std::chrono::microseconds;
+  std::cout << "restricted distance: "
+            << std::chrono::duration_cast<microseconds>(exact_time).count()
+            << " us; with bit-parallel filter: "
+            << std::chrono::duration_cast<microseconds>(filtered_time).count()
+            << " us" << std::endl;
+}
@@ -0,0 +1,123 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/deployer.h>
+#include <rime/lever/deployment_tasks.h>
+
+using namespace rime;
+
+namespace {
+
+// records the order in which builds run, without compiling anything.
+class TestDictionaryBuild : public DictionaryBuild {
+ public:
+  TestDictionaryBuild(const string& dict_name,
+                      const vector<string>& outputs,
+                      vector<string>* log,
+                      set<std::thread::id>* threads,
+                      std::mutex* mutex,
+                      bool fails = false,
+                      size_t table_memory_limit = 0)
+      : DictionaryBuild(dict_name, outputs),
+        log_(log),
+        threads_(threads),
+        mutex_(mutex),
+        fails_(fails) {
+    table_memory_limit_ = table_memory_limit;
+  }
+
+  bool Run() override {
+    {
+      std::lock_guard<std::mutex> lock(*mutex_);
+      log_->push_back(dict_name());
+      threads_->insert(std::this_thread::get_id());
+    }
+    if (fails_)
+      throw std::runtime_error("failed to compile");
+    return true;
+  }
+
+ private:
+  vector<string>* log_;
+  set<std::thread::id>* threads_;
+  std::mutex* mutex_;
+  bool fails_;
+};
+
+class TestWorkspaceUpdate : public WorkspaceUpdate {
+ public:
+  using WorkspaceUpdate::BuildDictionaries;
+};
+
+}  // namespace
+
+class RimeBuildDictionariesTest : public ::testing::Test {
+ protected:
+  void Add(const string& dict_name,
+           const vector<string>& outputs,
+           bool fails = false,
+           size_t table_memory_limit = 0) {
+    builds_.emplace_back(new TestDictionaryBuild(
+        dict_name, outputs, &log_, &threads_, &mutex_, fails,
+        table_memory_limit));
+  }
+
+  int Build() {
+    return TestWorkspaceUpdate().BuildDictionaries(&deployer_, builds_);
+  }
+
+  size_t IndexOf(const string& dict_name) const {
+    return std::find(log_.begin(), log_.end(), dict_name) - log_.begin();
+  }
+
+  Deployer deployer_;
+  vector<the<DictionaryBuild>> builds_;
+  vector<string> log_;
+  set<std::thread::id> threads_;
+  std::mutex mutex_;
+};
+
+TEST_F(RimeBuildDictionariesTest, GroupSharedOutputs) {
+  Add("a", {"a.table.bin", "common.prism.bin"});
+  Add("b", {"b.table.bin"});
+  Add("c", {"c.table.bin", "common.prism.bin"});
+  // does the same work as "a"
+  Add("a2", {"a.table.bin", "common.prism.bin"});
+  Add("d", {"d.table.bin", "c.table.bin"});
+  EXPECT_EQ(5, Build());
+  ASSERT_EQ(4, log_.size());
+  EXPECT_EQ(log_.size(), IndexOf("a2"));
+  // builds writing to a common file run in the order they were added
+  EXPECT_LT(IndexOf("a"), IndexOf("c"));
+  EXPECT_LT(IndexOf("c"), IndexOf("d"));
+  EXPECT_GT(log_.size(), IndexOf("b"));
+}
+
+TEST_F(RimeBuildDictionariesTest, FailedBuildLeavesGroupToRun) {
+  Add("a", {"a.table.bin", "common.prism.bin"}, true);
+  Add("c", {"c.table.bin", "common.prism.bin"});
+  Add("a2", {"a.table.bin", "common.prism.bin"});
+  Add("b", {"b.table.bin"});
+  // "a2" shares the failure of "a"
+  EXPECT_EQ(2, Build());
+  ASSERT_EQ(3, log_.size());
+  EXPECT_LT(IndexOf("a"), IndexOf("c"));
+  EXPECT_GT(log_.size(), IndexOf("b"));
+}
+
+TEST_F(RimeBuildDictionariesTest, MemoryLimitedBuildsRunOneByOne) {
+  Add("a", {"a.table.bin"});
+  Add("b", {"b.table.bin"}, false, 1 << 20);
+  Add("c", {"c.table.bin"});
+  EXPECT_EQ(3, Build());
+  ASSERT_EQ(3, log_.size());
+  EXPECT_EQ(vector<string>({"a", "b", "c"}), log_);
+  EXPECT_EQ(set<std::thread::id>({std::this_thread::get_id()}),
+            threads_);
+}
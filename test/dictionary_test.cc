@@ -101,3 +101,46 @@ TEST_F(RimeDictionaryTest, ScriptLookup) {
   EXPECT_EQ(9, e3->text.length());
   EXPECT_FALSE(d7.Next());
 }
+
+TEST_F(RimeDictionaryTest, PeekEntryView) {
+  ASSERT_TRUE(dict_->loaded());
+  rime::DictEntryIterator it;
+  dict_->LookupWords(&it, "z", true);
+  ASSERT_FALSE(it.exhausted());
+  auto held = it.Peek();
+  rime::string held_text = held->text;
+  for (int i = 0; i < 5 && !it.exhausted(); ++i) {
+    auto view = it.PeekView();
+    ASSERT_TRUE(bool(view));
+    auto e = it.Peek();
+    EXPECT_EQ(e->text, view.text());
+    EXPECT_EQ(e->code, *view.code);
+    EXPECT_DOUBLE_EQ(e->weight, view.weight);
+    EXPECT_EQ(e->remaining_code_length, view.remaining_code_length);
+    EXPECT_EQ(e->matching_code_size, view.matching_code_size);
+    it.Next();
+  }
+  // an entry taken from the iterator is not recycled
+  EXPECT_EQ(held_text, held->text);
+}
+
+TEST_F(RimeDictionaryTest, MergeChunksInOrder) {
+  ASSERT_TRUE(dict_->loaded());
+  rime::DictEntryIterator it;
+  // every syllable in the prism contributes a chunk
+  dict_->LookupWords(&it, "", true);
+  it.Sort();
+  ASSERT_FALSE(it.exhausted());
+  size_t count = 1;
+  auto previous = it.PeekView();
+  while (it.Next()) {
+    auto current = it.PeekView();
+    ASSERT_LE(previous.remaining_code_length, current.remaining_code_length);
+    if (previous.remaining_code_length == current.remaining_code_length) {
+      ASSERT_GE(previous.weight, current.weight);
+    }
+    previous = current;
+    ++count;
+  }
+  EXPECT_EQ(it.entry_count(), count);
+}
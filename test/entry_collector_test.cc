@@ -0,0 +1,87 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <rime/dict/entry_collector.h>
+
+using namespace rime;
+
+static path write_dict(const string& name, const string& contents) {
+  path file_path{name + ".dict.yaml"};
+  std::ofstream out(file_path.c_str(), std::ios::binary);
+  out << contents;
+  return file_path;
+}
+
+static string header(const string& name) {
+  return "---\nname: " + name + "\nversion: \"1\"\n...\n";
+}
+
+TEST(RimeEntryCollectorTest, CollectEntriesInPlace) {
+  path file_path = write_dict(
+      "entry_collector_test",
+      "# comments before the header\n"
+      "---\n"
+      "name: entry_collector_test\n"
+      "version: \"1\"\n"
+      "columns:\n"
+      "  - code\n"
+      "  - text\n"
+      "  - stem\n"
+      "  - weight\n"
+      "...\n"
+      "\n"
+      "# a comment\n"
+      "ni\t你\t\t10\r\n"
+      "hao\t好\tha \t \n"
+      "ni hao\t你好\n"
+      "wo\t\t\t1\n"
+      "# no comment\n"
+      "#\t井\n");
+  EntryCollector collector;
+  collector.Collect({file_path});
+  ASSERT_EQ(4, collector.num_entries);
+  EXPECT_EQ("你", collector.entries[0]->text);
+  EXPECT_EQ("ni", collector.entries[0]->raw_code.ToString());
+  EXPECT_EQ(10.0, collector.entries[0]->weight);
+  EXPECT_EQ("好", collector.entries[1]->text);
+  EXPECT_EQ(0.0, collector.entries[1]->weight);
+  EXPECT_EQ("你好", collector.entries[2]->text);
+  EXPECT_EQ("ni hao", collector.entries[2]->raw_code.ToString());
+  // comments are disabled
+  EXPECT_EQ("井", collector.entries[3]->text);
+  EXPECT_EQ("#", collector.entries[3]->raw_code.ToString());
+  EXPECT_EQ(1, collector.stems["好"].count("ha"));
+  EXPECT_EQ(0, collector.stems.count("你"));
+  EXPECT_EQ(3, collector.syllabary.size());
+  std::remove(file_path.string().c_str());
+}
+
+TEST(RimeEntryCollectorTest, CollectTablesInOrder) {
+  const int kNumTables = 8;
+  vector<path> dict_files;
+  for (int i = 0; i < kNumTables; ++i) {
+    string name = "entry_collector_test_" + std::to_string(i);
+    string rows;
+    for (int j = 0; j < 100; ++j) {
+      rows += std::to_string(i) + "_" + std::to_string(j) + "\tc" +
+              std::to_string(j) + "\n";
+    }
+    dict_files.push_back(write_dict(name, header(name) + rows));
+  }
+  dict_files.push_back(path{"nonexistent.dict.yaml"});
+  EntryCollector collector;
+  collector.Collect(dict_files);
+  ASSERT_EQ(kNumTables * 100, collector.num_entries);
+  for (int i = 0; i < kNumTables; ++i) {
+    for (int j = 0; j < 100; ++j) {
+      EXPECT_EQ(std::to_string(i) + "_" + std::to_string(j),
+                collector.entries[i * 100 + j]->text);
+    }
+  }
+  for (const auto& dict_file : dict_files) {
+    std::remove(dict_file.string().c_str());
+  }
+}
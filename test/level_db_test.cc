@@ -0,0 +1,48 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/dict/level_db.h>
+#include <rime/dict/user_db.h>
+
+using namespace rime;
+
+using TestDb = UserDbWrapper<LevelDb>;
+
+static void recreate(TestDb* db, const LevelDbOptions& options) {
+  if (db->Exists())
+    db->Remove();
+  db->set_options(options);
+  ASSERT_TRUE(db->Open());
+}
+
+TEST(RimeLevelDbTest, AccessWithTunedOptions) {
+  TestDb db(path{"level_db_test.userdb"}, "level_db_test");
+  LevelDbOptions options;
+  options.bloom_filter_bits = 10;
+  options.block_cache_size = 1 << 20;
+  options.fill_cache_on_query = true;
+  recreate(&db, options);
+  EXPECT_EQ(10, db.options().bloom_filter_bits);
+  EXPECT_TRUE(db.Update("ni hao \t你好", "c=1 d=1 t=1"));
+  EXPECT_TRUE(db.Update("ni \t你", "c=2 d=2 t=2"));
+  string value;
+  EXPECT_TRUE(db.Fetch("ni \t你", &value));
+  EXPECT_EQ("c=2 d=2 t=2", value);
+  EXPECT_FALSE(db.Fetch("ni \t泥", &value));
+  auto accessor = db.Query("ni ");
+  ASSERT_TRUE(bool(accessor));
+  string key;
+  int count = 0;
+  while (accessor->GetNextRecord(&key, &value))
+    ++count;
+  EXPECT_EQ(2, count);
+  accessor.reset();
+  EXPECT_TRUE(db.Close());
+  // reopening keeps options set explicitly
+  ASSERT_TRUE(db.Open());
+  EXPECT_TRUE(db.options().fill_cache_on_query);
+  EXPECT_TRUE(db.Close());
+  db.Remove();
+}
@@ -5,11 +5,13 @@
 // 2011-05-29 GONG Chen <chen.sst@gmail.com>
 //
 
+#include <random>
 #include <gtest/gtest.h>
 #include <rime/candidate.h>
 #include <rime/common.h>
 #include <rime/menu.h>
 #include <rime/translation.h>
+#include <rime/gear/uniquifier.h>
 
 using namespace rime;
 
@@ -77,3 +79,101 @@ TEST(RimeMenuTest, RecipeAlphaBeta) {
   the<Page> no_more_page(menu.CreatePage(5, 1));
   EXPECT_FALSE(bool(no_more_page));
 }
+
+TEST(RimeMenuTest, UniquifyCandidates) {
+  Menu menu;
+  auto translation = New<FifoTranslation>();
+  const char* texts[] = {"a", "b", "a", "c", "b", "a", "d"};
+  for (const char* text : texts) {
+    translation->Append(New<SimpleCandidate>("test", 0, 1, text));
+  }
+  menu.AddTranslation(translation);
+  Uniquifier uniquifier{Ticket()};
+  menu.AddFilter(&uniquifier);
+  // prepare the menu in several steps
+  EXPECT_EQ(2, menu.Prepare(2));
+  EXPECT_EQ(4, menu.Prepare(10));
+  the<Page> page(menu.CreatePage(10, 0));
+  ASSERT_TRUE(bool(page));
+  ASSERT_EQ(4, page->candidates.size());
+  EXPECT_EQ("a", page->candidates[0]->text());
+  EXPECT_EQ("b", page->candidates[1]->text());
+  EXPECT_EQ("c", page->candidates[2]->text());
+  EXPECT_EQ("d", page->candidates[3]->text());
+  auto uniquified = As<UniquifiedCandidate>(page->candidates[0]);
+  ASSERT_TRUE(bool(uniquified));
+  // the first "a" and both duplicates
+  EXPECT_EQ(3, uniquified->items().size());
+  EXPECT_FALSE(As<UniquifiedCandidate>(page->candidates[2]));
+}
+
+static vector<of<Translation>> make_translations(int num_translations,
+                                                 int num_candidates,
+                                                 unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> quality(0, 9);
+  // like translators, each translation yields candidates in order
+  vector<of<Translation>> translations;
+  for (int i = 0; i < num_translations; ++i) {
+    auto t = New<FifoTranslation>();
+    for (int j = 0; j < num_candidates; ++j) {
+      auto cand = New<SimpleCandidate>("test", 0, 1,
+                                       std::to_string(i) + ":" +
+                                           std::to_string(j));
+      cand->set_quality(10 * (num_candidates - j) + quality(gen));
+      t->Append(cand);
+    }
+    translations.push_back(t);
+  }
+  return translations;
+}
+
+// the original election, rescanning all translations after each candidate.
+static vector<string> merge_by_full_scan(vector<of<Translation>> translations) {
+  CandidateList candidates;
+  vector<string> result;
+  while (true) {
+    size_t k = 0;
+    for (; k < translations.size(); ++k) {
+      const auto& next =
+          k + 1 < translations.size() ? translations[k + 1] : nullptr;
+      if (translations[k]->Compare(next, candidates) <= 0) {
+        if (translations[k]->exhausted()) {
+          translations.erase(translations.begin() + k);
+          k = 0;
+          continue;
+        }
+        break;
+      }
+    }
+    if (k >= translations.size())
+      break;
+    result.push_back(translations[k]->Peek()->text());
+    translations[k]->Next();
+    if (translations[k]->exhausted())
+      translations.erase(translations.begin() + k);
+  }
+  return result;
+}
+
+static vector<string> merge(const vector<of<Translation>>& translations) {
+  CandidateList candidates;
+  MergedTranslation merged(candidates);
+  for (const auto& t : translations) {
+    merged += t;
+  }
+  vector<string> result;
+  while (!merged.exhausted()) {
+    result.push_back(merged.Peek()->text());
+    merged.Next();
+  }
+  return result;
+}
+
+TEST(RimeMergedTranslationTest, ElectInSameOrderAsFullScan) {
+  for (unsigned seed = 1; seed <= 20; ++seed) {
+    auto expected = merge_by_full_scan(make_translations(12, 20, seed));
+    auto actual = merge(make_translations(12, 20, seed));
+    EXPECT_EQ(expected, actual) << "seed: " << seed;
+  }
+}
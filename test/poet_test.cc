@@ -0,0 +1,124 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/common.h>
+#include <rime/component.h>
+#include <rime/registry.h>
+#include <rime/gear/grammar.h>
+#include <rime/gear/grammar_cache.h>
+#include <rime/gear/poet.h>
+
+using namespace rime;
+
+// favors "b" following "x", and remembers the contexts it has seen.
+class TestGrammar : public Grammar {
+ public:
+  TestGrammar(Config* config) {}
+  double Query(const string& context, const string& word, bool is_rear) {
+    contexts().insert(context);
+    return context == "x" && word == "b" ? 1.0 : 0.0;
+  }
+  static set<string>& contexts() {
+    static set<string> contexts;
+    return contexts;
+  }
+};
+
+static void add_word(WordGraph* graph,
+                     int start_pos,
+                     int end_pos,
+                     const string& text,
+                     double weight) {
+  auto entry = New<DictEntry>();
+  entry->text = text;
+  entry->weight = weight;
+  entry->code.push_back(0);
+  (*graph)[start_pos][end_pos].push_back(entry);
+}
+
+class RimePoetTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    add_word(&graph_, 0, 1, "a", 0.0);
+    add_word(&graph_, 0, 1, "x", -0.1);
+    add_word(&graph_, 1, 2, "b", 0.0);
+    add_word(&graph_, 2, 3, "c", 0.0);
+    add_word(&graph_, 0, 3, "ABC", 10.0);
+  }
+
+  WordGraph graph_;
+};
+
+TEST_F(RimePoetTest, MakeSentenceWithoutGrammar) {
+  Poet poet(nullptr, nullptr);
+  auto sentence = poet.MakeSentence(graph_, 3, "");
+  ASSERT_TRUE(bool(sentence));
+  // the single word spanning the whole input is not a sentence
+  EXPECT_EQ("abc", sentence->text());
+  EXPECT_EQ(3, sentence->size());
+  EXPECT_EQ(3, sentence->end());
+}
+
+TEST_F(RimePoetTest, MakeSentenceWithGrammar) {
+  Registry::instance().Register("grammar", new Component<TestGrammar>);
+  Poet poet(nullptr, nullptr);
+  TestGrammar::contexts().clear();
+  auto sentence = poet.MakeSentence(graph_, 3, "p");
+  Registry::instance().Unregister("grammar");
+  ASSERT_TRUE(bool(sentence));
+  EXPECT_EQ("xbc", sentence->text());
+  const auto& contexts = TestGrammar::contexts();
+  // the first word follows the preceding text
+  EXPECT_TRUE(contexts.find("p") != contexts.end());
+  EXPECT_TRUE(contexts.find("a") != contexts.end());
+  EXPECT_TRUE(contexts.find("x") != contexts.end());
+  // then look back 2 words
+  EXPECT_TRUE(contexts.find("xb") != contexts.end());
+  EXPECT_TRUE(contexts.find("ab") == contexts.end());
+}
+
+TEST_F(RimePoetTest, NoSentenceForUnreachableEnd) {
+  Poet poet(nullptr, nullptr);
+  EXPECT_FALSE(poet.MakeSentence(graph_, 4, ""));
+}
+
+class CountingGrammar : public Grammar {
+ public:
+  double Query(const string& context, const string& word, bool is_rear) {
+    ++count;
+    return context.length() + word.length() + (is_rear ? 0.5 : 0.0);
+  }
+  int count = 0;
+};
+
+TEST(RimeCachedGrammarTest, MemoizeQueries) {
+  auto* grammar = new CountingGrammar;
+  CachedGrammar cache(grammar, 2);
+  EXPECT_EQ(3.0, cache.Query("ab", "c", false));
+  EXPECT_EQ(3.5, cache.Query("ab", "c", true));
+  EXPECT_EQ(2, grammar->count);
+  // the same context given in parts
+  EXPECT_EQ(3.0, cache.QueryInContext({"a", "b"}, "c", false));
+  EXPECT_EQ(3.5, cache.Query("ab", "c", true));
+  EXPECT_EQ(2, grammar->count);
+  EXPECT_EQ(2, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_DOUBLE_EQ(0.5, cache.hit_rate());
+}
+
+TEST(RimeCachedGrammarTest, EvictLeastRecentlyUsed) {
+  auto* grammar = new CountingGrammar;
+  CachedGrammar cache(grammar, 2);
+  cache.Query("a", "x", false);
+  cache.Query("b", "x", false);
+  cache.Query("a", "x", false);  // "a" is now more recent than "b"
+  cache.Query("c", "x", false);  // evicts "b"
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(3, grammar->count);
+  cache.Query("a", "x", false);
+  EXPECT_EQ(3, grammar->count);
+  cache.Query("b", "x", false);
+  EXPECT_EQ(4, grammar->count);
+}
@@ -75,6 +75,56 @@ TEST_F(RimePrismTest, CommonPrefixMatch) {
   EXPECT_EQ(result[1].length, 7);  // goodbye
 }
 
+TEST_F(RimePrismTest, CommonPrefixMatchInBuffer) {
+  Prism::Match results[1];
+  // the key is a view into a longer text
+  std::string_view text("a goodbye!");
+  std::string_view key = text.substr(2, 7);
+  // there are more matches than the buffer holds
+  EXPECT_EQ(2, prism_->CommonPrefixSearch(key, results, 1));
+  EXPECT_EQ(results[0].value, 2);   // good
+  EXPECT_EQ(results[0].length, 4);  // good
+  EXPECT_EQ(0, prism_->CommonPrefixSearch(key.substr(0, 0), results, 1));
+}
+
+TEST_F(RimePrismTest, ResumeTraverse) {
+  Prism::Match results[2];
+  Prism::Cursor cursor;
+  EXPECT_EQ(0, prism_->Traverse("goo", &cursor, results, 2));
+  EXPECT_EQ(3, cursor.key_pos);
+  EXPECT_FALSE(cursor.stopped);
+  // typing on
+  ASSERT_EQ(1, prism_->Traverse("goodb", &cursor, results, 2));
+  EXPECT_EQ(results[0].value, 2);   // good
+  EXPECT_EQ(results[0].length, 4);  // good
+  EXPECT_EQ(5, cursor.key_pos);
+  ASSERT_EQ(1, prism_->Traverse("goodbyes", &cursor, results, 2));
+  EXPECT_EQ(results[0].value, 3);   // goodbye
+  EXPECT_EQ(results[0].length, 7);  // goodbye
+  EXPECT_TRUE(cursor.stopped);
+  EXPECT_EQ(7, cursor.key_pos);
+}
+
+TEST_F(RimePrismTest, TraverseIntoFullBuffer) {
+  Prism::Match results[1];
+  Prism::Cursor cursor;
+  ASSERT_EQ(1, prism_->Traverse("goodbye", &cursor, results, 1));
+  EXPECT_EQ(results[0].length, 4);  // good
+  EXPECT_EQ(4, cursor.key_pos);
+  ASSERT_EQ(1, prism_->Traverse("goodbye", &cursor, results, 1));
+  EXPECT_EQ(results[0].length, 7);  // goodbye
+  EXPECT_EQ(0, prism_->Traverse("goodbye", &cursor, results, 1));
+}
+
+TEST(RimePrismUnloadedTest, Traverse) {
+  Prism prism(path{"prism_test_unloaded.prism.bin"});
+  Prism::Match results[2];
+  Prism::Cursor cursor;
+  EXPECT_EQ(0, prism.Traverse("goodbye", &cursor, results, 2));
+  EXPECT_TRUE(cursor.stopped);
+  EXPECT_EQ(0, prism.CommonPrefixSearch("goodbye", results, 2));
+}
+
 TEST_F(RimePrismTest, ExpandSearch) {
   vector<Prism::Match> result;
 
@@ -0,0 +1,145 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <sstream>
+#include <gtest/gtest.h>
+#include <rime_api.h>
+#include <rime/candidate.h>
+#include <rime/context.h>
+#include <rime/key_event.h>
+#include <rime/schema.h>
+#include <rime/service.h>
+
+using namespace rime;
+
+static const char* kTestSchema = R"(
+engine:
+  processors:
+    - recognizer
+    - speller
+    - punctuator
+    - express_editor
+  segmentors:
+    - abc_segmentor
+    - punct_segmentor
+  translators:
+    - echo_translator
+    - punct_translator
+recognizer:
+  patterns:
+    reverse_lookup: "^`[a-z]*$"
+speller:
+  alphabet: abcdefghijklmnopqrstuvwxyz
+punctuator:
+  half_shape:
+    ",": [",", "，", "、"]
+menu:
+  alternative_select_labels: [①, ②, ③, ④, ⑤]
+)";
+
+class RimeApiTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    Service::instance().StartService();
+    session_id_ = Service::instance().CreateSession();
+    auto session = Service::instance().GetSession(session_id_);
+    ASSERT_TRUE(bool(session));
+    auto* config = new Config;
+    std::istringstream stream(kTestSchema);
+    ASSERT_TRUE(config->LoadFromStream(stream));
+    session->ApplySchema(new Schema("rime_api_test", config));
+  }
+
+  virtual void TearDown() {
+    Service::instance().DestroySession(session_id_);
+    Service::instance().StopService();
+  }
+
+  void ProcessKeys(const string& keys) {
+    auto session = Service::instance().GetSession(session_id_);
+    ASSERT_TRUE(bool(session));
+    session->ProcessKeys(KeySequence(keys));
+  }
+
+  static string str(const RimeStringSlice& slice) {
+    return slice.str ? string(slice.str, slice.length) : string();
+  }
+
+  SessionId session_id_ = kInvalidSessionId;
+};
+
+TEST_F(RimeApiTest, GetContextView) {
+  RIME_STRUCT(RimeContextView, view);
+  ASSERT_TRUE(RimeGetContextView(session_id_, &view));
+  EXPECT_EQ(nullptr, view.preedit.str);
+  EXPECT_EQ(0, view.num_candidates);
+
+  ProcessKeys("abc");
+  ASSERT_TRUE(RimeGetContextView(session_id_, &view));
+  EXPECT_EQ("abc", str(view.preedit));
+  EXPECT_EQ('\0', view.preedit.str[view.preedit.length]);
+  EXPECT_EQ(3, view.cursor_pos);
+  EXPECT_EQ("abc", str(view.commit_text_preview));
+  EXPECT_EQ(5, view.page_size);
+  EXPECT_EQ(0, view.page_no);
+  EXPECT_TRUE(view.is_last_page);
+  ASSERT_EQ(1, view.num_candidates);
+  EXPECT_EQ("abc", str(view.candidates[0].text));
+  EXPECT_EQ(nullptr, view.candidates[0].comment.str);
+  ASSERT_TRUE(view.select_labels != nullptr);
+  EXPECT_EQ("①", str(view.select_labels[0]));
+  EXPECT_EQ("⑤", str(view.select_labels[4]));
+
+  RimeClearComposition(session_id_);
+  ProcessKeys(",");
+  RIME_STRUCT(RimeContextView, punct_view);
+  ASSERT_TRUE(RimeGetContextView(session_id_, &punct_view));
+  EXPECT_EQ(",", str(punct_view.preedit));
+  ASSERT_EQ(3, punct_view.num_candidates);
+  EXPECT_EQ(",", str(punct_view.candidates[0].text));
+  EXPECT_EQ("，", str(punct_view.candidates[1].text));
+  EXPECT_EQ("、", str(punct_view.candidates[2].text));
+  EXPECT_EQ(0, punct_view.highlighted_candidate_index);
+  ASSERT_TRUE(punct_view.select_labels != nullptr);
+  EXPECT_EQ("②", str(punct_view.select_labels[1]));
+
+  // the slices stay valid until the next call
+  ProcessKeys(",");
+  EXPECT_EQ("，", str(punct_view.candidates[1].text));
+  EXPECT_EQ("②", str(punct_view.select_labels[1]));
+  ASSERT_TRUE(RimeGetContextView(session_id_, &punct_view));
+  EXPECT_EQ(1, punct_view.highlighted_candidate_index);
+  EXPECT_EQ("，", str(punct_view.candidates[1].text));
+}
+
+TEST_F(RimeApiTest, GetContextViewOfNoSession) {
+  RIME_STRUCT(RimeContextView, view);
+  EXPECT_FALSE(RimeGetContextView(kInvalidSessionId, &view));
+  RimeContextView uninitialized = {0};
+  EXPECT_FALSE(RimeGetContextView(session_id_, &uninitialized));
+}
+
+TEST_F(RimeApiTest, ProcessKeysComposesOnce) {
+  auto session = Service::instance().GetSession(session_id_);
+  ASSERT_TRUE(bool(session));
+  Context* ctx = session->context();
+  int compositions = 0;
+  auto connection = ctx->compose_notifier().connect(
+      [&compositions](Context*) { ++compositions; });
+  // through recognizer, speller and the rest of the chain
+  vector<bool> results;
+  EXPECT_EQ(6, session->ProcessKeys(KeySequence("abcdef"), &results));
+  EXPECT_EQ(vector<bool>(6, true), results);
+  EXPECT_EQ(1, compositions);
+  EXPECT_EQ("abcdef", ctx->input());
+  ASSERT_TRUE(ctx->HasMenu());
+  EXPECT_EQ("abcdef", ctx->GetSelectedCandidate()->text());
+  // the recognizer still reads the composition when a pattern can match
+  ctx->Clear();
+  compositions = 0;
+  EXPECT_EQ(3, session->ProcessKeys(KeySequence("`ab")));
+  EXPECT_EQ("`ab", ctx->input());
+  EXPECT_LE(1, compositions);
+  connection.disconnect();
+}
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <utility>
 #include <gtest/gtest.h>
+#include <rime/dict/corrector.h>
 #include <rime/dict/prism.h>
 #include <rime/algo/syllabifier.h>
 
@@ -153,10 +154,120 @@ TEST_F(RimeSyllabifierTest, TransposedSyllableGraph) {
   const rime::string input("changan");
   s.BuildSyllableGraph(input, *prism_, &g);
   ASSERT_NE(1, g.indices.size());
-  EXPECT_EQ(2, g.indices[0].size());
-  EXPECT_FALSE(g.indices[0].end() == g.indices[0].find(syllable_id_["chan"]));
-  EXPECT_FALSE(g.indices[0].end() == g.indices[0].find(syllable_id_["chang"]));
-  ASSERT_EQ(1, g.indices[0][syllable_id_["chan"]].size());
-  ASSERT_FALSE(NULL == g.indices[0][syllable_id_["chan"]][0]);
-  EXPECT_EQ(4, g.indices[0][syllable_id_["chan"]][0]->end_pos);
+  EXPECT_EQ(2, g.indices.syllables(0).size());
+  EXPECT_FALSE(NULL == g.indices.Find(0, syllable_id_["chang"]));
+  auto chan = g.indices.Find(0, syllable_id_["chan"]);
+  ASSERT_FALSE(NULL == chan);
+  ASSERT_EQ(1, g.indices.spellings(*chan).size());
+  EXPECT_EQ(4, g.indices.spellings(*chan)[0].end_pos);
+  EXPECT_TRUE(NULL == g.indices.Find(0, syllable_id_["an"]));
+  EXPECT_EQ(0, g.indices.syllables(input.length()).size());
+}
+
+static void ExpectSameSyllableGraph(const rime::SyllableGraph& expected,
+                                    const rime::SyllableGraph& actual) {
+  EXPECT_EQ(expected.input_length, actual.input_length);
+  EXPECT_EQ(expected.interpreted_length, actual.interpreted_length);
+  EXPECT_TRUE(expected.vertices == actual.vertices);
+  ASSERT_EQ(expected.edges.size(), actual.edges.size());
+  for (auto x = expected.edges.begin(), y = actual.edges.begin();
+       x != expected.edges.end(); ++x, ++y) {
+    ASSERT_EQ(x->first, y->first);
+    ASSERT_EQ(x->second.size(), y->second.size());
+    for (auto u = x->second.begin(), v = y->second.begin();
+         u != x->second.end(); ++u, ++v) {
+      ASSERT_EQ(u->first, v->first);
+      ASSERT_EQ(u->second.size(), v->second.size());
+      for (auto p = u->second.begin(), q = v->second.begin();
+           p != u->second.end(); ++p, ++q) {
+        EXPECT_EQ(p->first, q->first);
+        EXPECT_EQ(p->second.type, q->second.type);
+        EXPECT_EQ(p->second.credibility, q->second.credibility);
+      }
+    }
+  }
+}
+
+TEST_F(RimeSyllabifierTest, IncrementalSyllabification) {
+  rime::SyllabifierCache cache;
+  rime::Syllabifier s;
+  s.EnableCache(&cache);
+  const rime::string inputs[] = {
+      "c",    "ch",    "cha",    "chan",     "chang",    "changa",
+      "changan", "changant", "changantu", "changantuan", "changantu",
+      "changan", "changtu", "tuan", "tuanan", "",
+  };
+  for (const auto& input : inputs) {
+    rime::SyllableGraph expected;
+    rime::Syllabifier().BuildSyllableGraph(input, *prism_, &expected);
+    rime::SyllableGraph actual;
+    s.BuildSyllableGraph(input, *prism_, &actual);
+    ExpectSameSyllableGraph(expected, actual);
+    EXPECT_EQ(input, cache.input);
+  }
+}
+
+// counts the searches made by a NearSearchCorrector.
+class CountingCorrector : public rime::NearSearchCorrector {
+ public:
+  void ToleranceSearch(const rime::Prism& prism,
+                       const rime::string& key,
+                       rime::corrector::Corrections* results,
+                       size_t tolerance) override {
+    ++count;
+    NearSearchCorrector::ToleranceSearch(prism, key, results, tolerance);
+  }
+  int count = 0;
+};
+
+TEST_F(RimeSyllabifierTest, IncrementalCorrection) {
+  CountingCorrector uncached_corrector;
+  CountingCorrector cached_corrector;
+  rime::SyllabifierCache cache;
+  rime::Syllabifier s;
+  s.EnableCorrection(&cached_corrector);
+  s.EnableCache(&cache);
+  const rime::string inputs[] = {
+      "c",       "cg",      "cga",      "cgan",     "cgant",
+      "cgantu",  "cgantua", "cgantuan", "cgantua",  "xgantuan",
+      "xgantuan", "ahan",   "",
+  };
+  for (const auto& input : inputs) {
+    rime::Syllabifier fresh;
+    fresh.EnableCorrection(&uncached_corrector);
+    rime::SyllableGraph expected;
+    fresh.BuildSyllableGraph(input, *prism_, &expected);
+    rime::SyllableGraph actual;
+    s.BuildSyllableGraph(input, *prism_, &actual);
+    ExpectSameSyllableGraph(expected, actual);
+  }
+  EXPECT_LT(cached_corrector.count, uncached_corrector.count);
+}
+
+TEST(RimeSyllabifierCacheTest, CorrectLongSpellings) {
+  rime::path file_path("syllabifier_long_test.bin");
+  rime::Prism prism(file_path);
+  const rime::string long_spelling("abcdefghijklmnopqrstu");
+  prism.Build({long_spelling, "xy"});
+  CountingCorrector uncached_corrector;
+  CountingCorrector cached_corrector;
+  rime::SyllabifierCache cache;
+  rime::Syllabifier s;
+  s.EnableCorrection(&cached_corrector);
+  s.EnableCache(&cache);
+  // a typo at the end of a spelling longer than 16 characters
+  rime::string input("abcdefghijklmnopqrsty");
+  for (size_t length = 1; length <= input.length(); ++length) {
+    rime::Syllabifier fresh;
+    fresh.EnableCorrection(&uncached_corrector);
+    rime::SyllableGraph expected;
+    fresh.BuildSyllableGraph(input.substr(0, length), prism, &expected);
+    rime::SyllableGraph actual;
+    s.BuildSyllableGraph(input.substr(0, length), prism, &actual);
+    ExpectSameSyllableGraph(expected, actual);
+  }
+  rime::SyllableGraph graph;
+  s.BuildSyllableGraph(input, prism, &graph);
+  EXPECT_EQ(input.length(), graph.interpreted_length);
+  prism.Remove();
 }
@@ -89,3 +89,71 @@ TEST(RimeUserDbTest, Query) {
   }
   db.Close();
 }
+
+TEST(RimeUserDbValueTest, BinaryRoundTrip) {
+  UserDbValue v;
+  v.commits = -3;
+  v.dee = 1.0 / 3;
+  v.tick = (TickCount(1) << 40) + 7;
+  v.elements = {"你", "好", string(200, 'x')};
+  string packed = v.PackBinary();
+  EXPECT_TRUE(UserDbValue::IsBinary(packed));
+  UserDbValue u;
+  ASSERT_TRUE(u.Unpack(packed));
+  EXPECT_EQ(v.commits, u.commits);
+  EXPECT_EQ(v.dee, u.dee);
+  EXPECT_EQ(v.tick, u.tick);
+  EXPECT_EQ(v.elements, u.elements);
+  // truncated
+  EXPECT_FALSE(u.Unpack(packed.substr(0, packed.length() - 1)));
+  EXPECT_FALSE(u.Unpack(packed.substr(0, 5)));
+}
+
+TEST(RimeUserDbValueTest, AcceptLegacyText) {
+  EXPECT_FALSE(UserDbValue::IsBinary(""));
+  string text("c=2 d=0.5 t=100 e=你/好");
+  EXPECT_FALSE(UserDbValue::IsBinary(text));
+  UserDbValue v(text);
+  EXPECT_EQ(2, v.commits);
+  EXPECT_EQ(0.5, v.dee);
+  EXPECT_EQ(100, v.tick);
+  ASSERT_EQ(2, v.elements.size());
+  // converts to binary and back to the same text
+  EXPECT_EQ(text, UserDbValue(v.PackBinary()).Pack());
+}
+
+TEST(RimeUserDbValueTest, BackupInText) {
+  TestDb db(path{"user_db_test.txt"}, "user_db_test");
+  if (db.Exists())
+    db.Remove();
+  db.Open();
+  UserDbValue v;
+  v.commits = 1;
+  v.tick = 5;
+  // text dbs cannot keep binary values
+  EXPECT_EQ(v.Pack(), UserDbHelper(&db).PackValue(v));
+  EXPECT_TRUE(db.Update("ni hao \t你好", v.PackBinary()));
+  path snapshot{"user_db_test.snapshot.userdb.txt"};
+  EXPECT_TRUE(db.Backup(snapshot));
+  db.Close();
+  TestDb restored(snapshot, "user_db_test");
+  ASSERT_TRUE(restored.OpenReadOnly());
+  string value;
+  ASSERT_TRUE(restored.Fetch("ni hao \t你好", &value));
+  EXPECT_EQ(v.Pack(), value);
+  restored.Close();
+}
+
+TEST(RimeUserDbTest, RestoreStartsNewGeneration) {
+  TestDb db(path{"user_db_test.txt"}, "user_db_test");
+  if (db.Exists())
+    db.Remove();
+  db.Open();
+  EXPECT_TRUE(db.Update("ni \t你", UserDbValue().Pack()));
+  path snapshot{"user_db_test.snapshot.userdb.txt"};
+  EXPECT_TRUE(db.Backup(snapshot));
+  uint64_t generation = UserDb::generation();
+  EXPECT_TRUE(db.Restore(snapshot));
+  EXPECT_EQ(generation + 1, UserDb::generation());
+  db.Close();
+}
@@ -0,0 +1,294 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <gtest/gtest.h>
+#include <rime/dict/db_index.h>
+#include <rime/dict/text_db.h>
+#include <rime/dict/user_db.h>
+#include <rime/dict/user_dictionary.h>
+
+using namespace rime;
+
+class RimeUserDictionaryTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    db_ = New<UserDbWrapper<TextDb>>(path{"user_dictionary_test.userdb.txt"},
+                                     "user_dictionary_test");
+    if (db_->Exists())
+      db_->Remove();
+    ASSERT_TRUE(db_->Open());
+    dict_.reset(new UserDictionary("user_dictionary_test", db_));
+    ASSERT_TRUE(dict_->Load());
+  }
+
+  virtual void TearDown() {
+    dict_.reset();
+    db_->Close();
+  }
+
+  static DictEntry MakeEntry(const string& code, const string& text) {
+    DictEntry entry;
+    entry.custom_code = code;
+    entry.text = text;
+    return entry;
+  }
+
+  int CountWords(const string& input) {
+    UserDictEntryIterator iter;
+    return dict_->LookupWords(&iter, input, false);
+  }
+
+  an<Db> db_;
+  the<UserDictionary> dict_;
+};
+
+TEST_F(RimeUserDictionaryTest, WriteBehind) {
+  dict_->set_max_pending_updates(2);
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  dict_->CommitPendingTransaction();
+  // visible to lookups before it is written to db
+  EXPECT_EQ(1, dict_->pending_updates());
+  EXPECT_EQ(1, CountWords("ni hao"));
+  string value;
+  EXPECT_FALSE(db_->Fetch("ni hao \t你好", &value));
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "泥豪"), 1));
+  EXPECT_EQ(2, CountWords("ni hao"));
+  dict_->CommitPendingTransaction();
+  // reached the threshold
+  EXPECT_EQ(0, dict_->pending_updates());
+  EXPECT_TRUE(db_->Fetch("ni hao \t你好", &value));
+  EXPECT_EQ(1, UserDbValue(value).tick);
+  EXPECT_TRUE(db_->MetaFetch("/tick", &value));
+  EXPECT_EQ("2", value);
+  EXPECT_EQ(2, CountWords("ni hao"));
+}
+
+TEST_F(RimeUserDictionaryTest, RevertPendingTransaction) {
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  dict_->CommitPendingTransaction();
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni ", "你"), 0));
+  EXPECT_EQ(2, dict_->tick());
+  EXPECT_TRUE(dict_->RevertRecentTransaction());
+  EXPECT_EQ(1, dict_->tick());
+  EXPECT_EQ(1, dict_->pending_updates());
+  // only "ni hao" remains
+  EXPECT_EQ(1, CountWords("ni"));
+  EXPECT_TRUE(dict_->FlushPendingUpdates());
+  string value;
+  ASSERT_TRUE(db_->Fetch("ni hao \t你好", &value));
+  EXPECT_EQ(1, UserDbValue(value).commits);
+}
+
+TEST_F(RimeUserDictionaryTest, FlushOnDestruction) {
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni ", "你"), 1));
+  dict_.reset();
+  string value;
+  EXPECT_TRUE(db_->Fetch("ni \t你", &value));
+}
+
+static vector<string> ListKeys(an<DbAccessor> accessor) {
+  vector<string> keys;
+  string key, value;
+  while (accessor->GetNextRecord(&key, &value)) {
+    keys.push_back(key);
+  }
+  return keys;
+}
+
+TEST_F(RimeUserDictionaryTest, IndexSeeksAndMergesUpdates) {
+  db_->Update("a \tA", "1");
+  db_->Update("b \tB", "2");
+  db_->Update("b c \tBC", "3");
+  db_->Update("d \tD", "4");
+  DbIndex index;
+  ASSERT_TRUE(index.Build(db_.get()));
+  EXPECT_EQ(4, index.size());
+  EXPECT_EQ((vector<string>{"b \tB", "b c \tBC"}),
+            ListKeys(index.Query("b")));
+  string value;
+  EXPECT_TRUE(index.Fetch("d \tD", &value));
+  EXPECT_EQ("4", value);
+  EXPECT_FALSE(index.Fetch("c \tC", &value));
+  index.Update("c \tC", "5");
+  index.Update("b \tB", "6");
+  auto accessor = index.Query("");
+  ASSERT_TRUE(accessor->Jump("b c"));
+  EXPECT_EQ((vector<string>{"b c \tBC", "c \tC", "d \tD"}),
+            ListKeys(accessor));
+  EXPECT_TRUE(index.Fetch("b \tB", &value));
+  EXPECT_EQ("6", value);
+  // merging the delta gives the same records
+  for (size_t i = 0; i < DbIndex::kMaxDeltaSize; ++i) {
+    index.Update("e" + std::to_string(i) + " \tE", "7");
+  }
+  EXPECT_EQ(5 + DbIndex::kMaxDeltaSize, index.size());
+  EXPECT_EQ((vector<string>{"b \tB", "b c \tBC"}),
+            ListKeys(index.Query("b")));
+  EXPECT_EQ(DbIndex::kMaxDeltaSize, ListKeys(index.Query("e")).size());
+  EXPECT_TRUE(index.Fetch("b \tB", &value));
+  EXPECT_EQ("6", value);
+}
+
+TEST_F(RimeUserDictionaryTest, LookupThroughIndex) {
+  db_->Update("ni \t你", UserDbValue("c=1 d=1 t=1").Pack());
+  auto index = New<DbIndex>();
+  dict_.reset(new UserDictionary("user_dictionary_test", db_));
+  dict_->EnableIndex(index);
+  ASSERT_TRUE(dict_->Load());
+  EXPECT_TRUE(index->loaded());
+  EXPECT_EQ(1, CountWords("ni"));
+  dict_->set_max_pending_updates(0);
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni ", "泥"), 1));
+  dict_->CommitPendingTransaction();
+  EXPECT_EQ(0, dict_->pending_updates());
+  // written to both db and index
+  string value;
+  EXPECT_TRUE(db_->Fetch("ni \t泥", &value));
+  EXPECT_TRUE(index->Fetch("ni \t泥", &value));
+  EXPECT_EQ(2, CountWords("ni"));
+}
+
+TEST_F(RimeUserDictionaryTest, RebuildIndexInBackground) {
+  auto index = New<DbIndex>();
+  dict_.reset(new UserDictionary("user_dictionary_test", db_));
+  dict_->EnableIndex(index);
+  ASSERT_TRUE(dict_->Load());
+  EXPECT_EQ(0, CountWords("ni"));
+  // synced
+  db_->Update("ni \t你", UserDbValue("c=1 d=1 t=1").Pack());
+  UserDb::NewGeneration();
+  // read from db until the index is rebuilt
+  EXPECT_EQ(1, CountWords("ni"));
+  for (int i = 0; i < 100 && index->generation() != UserDb::generation();
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CountWords("ni");
+  }
+  EXPECT_EQ(UserDb::generation(), index->generation());
+  EXPECT_EQ(1, index->size());
+  EXPECT_EQ(1, CountWords("ni"));
+}
+
+TEST_F(RimeUserDictionaryTest, ShareUpdatesOfDb) {
+  auto cache = New<UserDbCache>(db_);
+  dict_.reset(new UserDictionary("user_dictionary_test", db_, cache));
+  ASSERT_TRUE(dict_->Load());
+  UserDictionary other("user_dictionary_test", db_, cache);
+  ASSERT_TRUE(other.Load());
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  dict_->CommitPendingTransaction();
+  // learned in one session, seen in another before written to db
+  UserDictEntryIterator iter;
+  EXPECT_EQ(1, other.LookupWords(&iter, "ni hao", false));
+  EXPECT_EQ(1, other.tick());
+  other.NewTransaction();
+  EXPECT_TRUE(other.UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  other.CommitPendingTransaction();
+  EXPECT_EQ(2, dict_->tick());
+  EXPECT_TRUE(dict_->FlushPendingUpdates());
+  EXPECT_EQ(0, other.pending_updates());
+  // both updates count
+  string value;
+  ASSERT_TRUE(db_->Fetch("ni hao \t你好", &value));
+  UserDbValue v(value);
+  EXPECT_EQ(2, v.commits);
+  EXPECT_EQ(2, v.tick);
+}
+
+TEST_F(RimeUserDictionaryTest, ShareTickCountOfDb) {
+  auto cache = New<UserDbCache>(db_);
+  dict_.reset(new UserDictionary("user_dictionary_test", db_, cache));
+  ASSERT_TRUE(dict_->Load());
+  UserDictionary other("user_dictionary_test", db_, cache);
+  ASSERT_TRUE(other.Load());
+  for (int i = 0; i < 3; ++i) {
+    dict_->NewTransaction();
+    EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("hao ", "好"), 1));
+  }
+  dict_->CommitPendingTransaction();
+  // the entry updated at tick 3 is not taken as from the future
+  other.NewTransaction();
+  EXPECT_TRUE(other.UpdateEntry(MakeEntry("hao ", "好"), 0));
+  other.CommitPendingTransaction();
+  EXPECT_TRUE(other.FlushPendingUpdates());
+  string value;
+  ASSERT_TRUE(db_->Fetch("hao \t好", &value));
+  EXPECT_EQ(3, UserDbValue(value).tick);
+  EXPECT_EQ(3, UserDbValue(value).commits);
+  // re-read from db once it has been restored or synced
+  EXPECT_TRUE(db_->MetaUpdate("/tick", "10"));
+  UserDb::NewGeneration();
+  EXPECT_EQ(10, dict_->tick());
+  EXPECT_EQ(10, other.tick());
+}
+
+TEST_F(RimeUserDictionaryTest, SyncWhileUpdatesPending) {
+  dict_->NewTransaction();
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni hao ", "你好"), 1));
+  EXPECT_TRUE(dict_->UpdateEntry(MakeEntry("ni ", "你"), 1));
+  dict_->UpdateTickCount(1);
+  dict_->CommitPendingTransaction();
+  EXPECT_EQ(2, dict_->pending_updates());
+  {
+    // merges a snapshot from another device
+    UserDbMerger merger(db_.get());
+    merger.MetaPut("/tick", "5");
+    merger.Put("ni hao \t你好", UserDbValue("c=4 d=2 t=5").Pack());
+    merger.Put("hao \t好", UserDbValue("c=3 d=1 t=4").Pack());
+  }
+  EXPECT_EQ(5, dict_->tick());
+  EXPECT_EQ(2, dict_->pending_updates());
+  EXPECT_TRUE(dict_->FlushPendingUpdates());
+  // the merged records are not written over by the updates made before
+  string value;
+  ASSERT_TRUE(db_->Fetch("ni hao \t你好", &value));
+  EXPECT_EQ(4, UserDbValue(value).commits);
+  EXPECT_EQ(5, UserDbValue(value).tick);
+  ASSERT_TRUE(db_->Fetch("ni \t你", &value));
+  EXPECT_EQ(1, UserDbValue(value).commits);
+  ASSERT_TRUE(db_->Fetch("hao \t好", &value));
+  EXPECT_EQ(3, UserDbValue(value).commits);
+  ASSERT_TRUE(db_->MetaFetch("/tick", &value));
+  EXPECT_EQ("5", value);
+}
+
+TEST(RimeUserDictionaryComponentTest, ShareUpdatesOfDb) {
+  const string dict_name = "user_dictionary_component_test";
+  std::remove((dict_name + ".userdb.txt").c_str());
+  UserDictionaryComponent component;
+  the<UserDictionary> dict(component.Create(dict_name, "plain_userdb"));
+  the<UserDictionary> other(component.Create(dict_name, "plain_userdb"));
+  ASSERT_TRUE(dict && other);
+  ASSERT_TRUE(dict->Load());
+  ASSERT_TRUE(other->Load());
+  DictEntry entry;
+  entry.custom_code = "ni ";
+  entry.text = "你";
+  EXPECT_TRUE(dict->UpdateEntry(entry, 1));
+  EXPECT_EQ(1, other->pending_updates());
+  EXPECT_EQ(1, other->tick());
+  // not held for long enough to be written back
+  component.FlushPendingUpdates();
+  EXPECT_EQ(1, other->pending_updates());
+  dict.reset();
+  other.reset();
+  // written to db when the dictionaries are closed
+  the<UserDictionary> reopened(component.Create(dict_name, "plain_userdb"));
+  ASSERT_TRUE(reopened->Load());
+  EXPECT_EQ(0, reopened->pending_updates());
+  EXPECT_EQ(1, reopened->tick());
+  UserDictEntryIterator iter;
+  EXPECT_EQ(1, reopened->LookupWords(&iter, "ni", false));
+}
@@ -0,0 +1,36 @@
+//
+// Copyright RIME Developers
+// Distributed under the BSD License
+//
+#include <gtest/gtest.h>
+#include <rime/worker_pool.h>
+
+using namespace rime;
+
+TEST(RimeWorkerPoolTest, ResultsInOrderOfPosting) {
+  WorkerPool pool(2);
+  vector<std::future<int>> results;
+  for (int i = 0; i < 100; ++i) {
+    results.push_back(pool.Post([i] { return i * i; }));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i * i, results[i].get());
+  }
+}
+
+TEST(RimeWorkerPoolTest, RunsInCallingThreadWithoutWorkers) {
+  WorkerPool pool(0);
+  auto caller = std::this_thread::get_id();
+  auto result = pool.Post([] { return std::this_thread::get_id(); });
+  ASSERT_EQ(std::future_status::ready,
+            result.wait_for(std::chrono::seconds(0)));
+  EXPECT_EQ(caller, result.get());
+}
+
+TEST(RimeWorkerPoolTest, ShutdownShared) {
+  EXPECT_EQ(4, WorkerPool::Shared().Post([] { return 4; }).get());
+  WorkerPool::ShutdownShared();
+  // created again on next use
+  EXPECT_EQ(5, WorkerPool::Shared().Post([] { return 5; }).get());
+  WorkerPool::ShutdownShared();
+}
@@ -33,11 +33,11 @@ void access(rime::Table* table,
             rime::TableAccessor accessor,
             std::ofstream& fout) {
   while (!accessor.exhausted()) {
-    auto word = table->GetEntryText(*accessor.entry());
+    auto word = table->GetEntryText(accessor.text());
     fout << word << "\t";
     outCode(table, accessor.code(), fout);
 
-    auto weight = accessor.entry()->weight;
+    auto weight = accessor.weight();
     if (weight >= 0) {
       fout << "\t" << exp(weight);
     }
@@ -72,7 +72,7 @@ void traversal(rime::Table* table, std::ofstream& fout) {
 
   fout << std::fixed;
   fout << std::setprecision(0);
-  rime::TableQuery query(table->metadata()->index.get());
+  rime::TableQuery query(table->NewQuery());
   recursion(table, &query, fout);
 }
 